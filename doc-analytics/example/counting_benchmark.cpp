@@ -0,0 +1,187 @@
+/**
+ * Term Counting Benchmark
+ *
+ * Counts the terms of many small in-memory documents on one thread, the way a
+ * pipeline worker does, and reports time and heap allocations per document for
+ *  - the previous path: a node-based hash map of term views plus owned strings,
+ *    then a std::map from term id to count per document, and
+ *  - DocumentProcessor::processText: a reused open-addressing table with an
+ *    arena for copied keys, compacted into a sorted (term, count) array.
+ * Both have to produce the same counts. Also reports what the collection keeps
+ * per stored document, and the cost of counting bigrams and trigrams into a
+ * fresh collection with an interning dictionary and with a hashed one.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "tf-idf.h"
+
+// Every heap allocation of the program goes through here
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// DocumentStats is over-aligned (its MinHash signature), so it comes through here
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocations++;
+    size_t align = static_cast<size_t>(alignment);
+    if (void* p = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+// Short documents over a Zipf-like vocabulary, some words capitalized or punctuated
+std::vector<std::string> generateDocuments(size_t count) {
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<std::string> documents;
+    for (size_t d = 0; d < count; ++d) {
+        std::string text;
+        for (size_t i = 0, length = 300 + rng() % 1200; i < length; ++i) {
+            size_t word = static_cast<size_t>(std::pow(30000.0, uniform(rng)));
+            text += (rng() % 10 == 0 ? "Word" : "word") + std::to_string(word);
+            text += rng() % 15 == 0 ? ", " : " ";
+        }
+        documents.push_back(std::move(text));
+    }
+    return documents;
+}
+
+// The counting path before arena counting, kept as the reference
+std::map<TermId, int> previousCounts(std::string_view text, TermDictionary& dictionary) {
+    std::unordered_map<std::string_view, int> counts;
+    std::deque<std::string> ownedKeys;
+    Tokenizer tokenizer;
+    tokenizer.tokenize(text, [&](std::string_view term) {
+        if (term.length() > 2) {
+            auto it = counts.find(term);
+            if (it != counts.end()) {
+                it->second++;
+                return;
+            }
+            bool stable = term.data() >= text.data() && term.data() + term.size() <= text.data() + text.size();
+            counts.emplace(stable ? term : std::string_view(ownedKeys.emplace_back(term)), 1);
+        }
+    });
+    std::map<TermId, int> termFrequency;
+    for (const auto& [term, count] : counts) {
+        termFrequency[dictionary.intern(term)] = count;
+    }
+    return termFrequency;
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 20000;
+    std::vector<std::string> documents = generateDocuments(count);
+    auto collection = std::make_shared<DocumentCollection>();
+    TermDictionary& dictionary = collection->getDictionary();
+
+    // Both paths see a warm dictionary, so interning new terms is not counted
+    DocumentProcessor processor("doc.txt", collection);
+    for (const auto& text : documents) {
+        processor.processText(text);
+    }
+
+    std::vector<std::map<TermId, int>> reference;
+    reference.reserve(count);
+    size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& text : documents) {
+        reference.push_back(previousCounts(text, dictionary));
+    }
+    std::chrono::duration<double> previousTime = std::chrono::steady_clock::now() - start;
+    size_t previousAllocations = allocations - before;
+
+    std::vector<DocumentStats> stats;
+    stats.reserve(count);
+    before = allocations;
+    start = std::chrono::steady_clock::now();
+    for (const auto& text : documents) {
+        stats.push_back(processor.processText(text));
+    }
+    std::chrono::duration<double> arenaTime = std::chrono::steady_clock::now() - start;
+    size_t arenaAllocations = allocations - before;
+
+    bool same = true;
+    for (size_t d = 0; d < count; ++d) {
+        const TermCounts& counts = stats[d].termFrequency;
+        same = same && counts.size() == reference[d].size() &&
+               std::equal(counts.begin(), counts.end(), reference[d].begin(),
+                          [](const TermCount& a, const std::pair<const TermId, int>& b) {
+                              return a.term == b.first && a.count == b.second;
+                          });
+    }
+
+    size_t terms = 0;
+    for (const auto& doc : stats) {
+        terms += doc.termFrequency.size();
+    }
+    std::cout << "Documents: " << count << ", " << terms / count << " distinct terms each on average\n\n";
+    std::cout << std::left << std::setw(22) << "counting" << std::setw(14) << "us/doc"
+              << "allocations/doc\n" << std::fixed << std::setprecision(2);
+    std::cout << std::setw(22) << "map + owned strings" << std::setw(14) << previousTime.count() * 1e6 / count
+              << static_cast<double>(previousAllocations) / count << "\n";
+    std::cout << std::setw(22) << "arena + flat array" << std::setw(14) << arenaTime.count() * 1e6 / count
+              << static_cast<double>(arenaAllocations) / count << "\n";
+
+    // What the collection keeps per document: flat arrays now, before that one
+    // shared DocumentStats (control block, signature, name and count buffers)
+    DocumentCollection stored;
+    size_t sharedBytes = 0;
+    for (const auto& doc : stats) {
+        stored.addDocument(doc);
+        sharedBytes += sizeof(std::shared_ptr<DocumentStats>) + 16 + sizeof(DocumentStats) +
+                       doc.termFrequency.capacity() * sizeof(TermCount) +
+                       (doc.docName.size() > 15 ? doc.docName.capacity() + 1 : 0);
+    }
+    std::cout << "\nStored bytes/doc:  shared DocumentStats " << static_cast<double>(sharedBytes) / count
+              << ", flat arrays " << static_cast<double>(stored.getStorageBytes()) / count << "\n";
+
+    // Phrases on a cold collection, so dictionary growth is part of the cost. Random
+    // text makes nearly every phrase new, so an interned run is kept short.
+    size_t phraseCount = std::min<size_t>(count, 5000);
+    std::cout << "\n" << std::setw(22) << "phrases" << std::setw(14) << "us/doc" << std::setw(18)
+              << "allocations/doc" << "term ids\n";
+    for (unsigned hashBits : { 0u, 20u }) {
+        for (size_t maxNgram : { 1, 2, 3 }) {
+            auto fresh = std::make_shared<DocumentCollection>(std::make_shared<TermDictionary>(hashBits));
+            ProcessingOptions options;
+            options.maxNgram = maxNgram;
+            DocumentProcessor phraseProcessor("doc.txt", fresh, options);
+            before = allocations;
+            start = std::chrono::steady_clock::now();
+            for (size_t d = 0; d < phraseCount; ++d) {
+                phraseProcessor.processText(documents[d]);
+            }
+            std::chrono::duration<double> phraseTime = std::chrono::steady_clock::now() - start;
+            std::string name = std::string("1..") + std::to_string(maxNgram) +
+                               (hashBits ? ", hashed 2^" + std::to_string(hashBits) : ", interned");
+            std::cout << std::setw(22) << name << std::setw(14) << phraseTime.count() * 1e6 / phraseCount
+                      << std::setw(18) << static_cast<double>(allocations - before) / phraseCount
+                      << fresh->getDictionary().size() << "\n";
+        }
+    }
+    std::cout << "\nCounts: " << (same ? "identical" : "DIFFER") << "\n";
+    return same ? 0 : 1;
+}
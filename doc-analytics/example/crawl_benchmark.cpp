@@ -0,0 +1,110 @@
+/**
+ * Crawl Benchmark
+ *
+ * Writes a nested directory tree of small synthetic documents (2-8 KB), then
+ * ingests it by listing the whole tree first and handing the paths to
+ * IngestionEngine, and with the CrawlPipeline, where listing, reads and
+ * tokenizing overlap, reading with blocking pread and with io_uring batches.
+ * Reports the time of each, the pipeline's per-stage counters, and checks that
+ * all produce the same documents and vocabulary.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "tf-idf.h"
+#include "crawler.h"
+
+// `directories` folders spread over two levels, `filesPerDirectory` documents each
+void generateTree(const fs::path& root, size_t directories, size_t filesPerDirectory) {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (size_t d = 0; d < directories; ++d) {
+        fs::path directory = root / ("group" + std::to_string(d % 8)) / ("dir" + std::to_string(d));
+        fs::create_directories(directory);
+        for (size_t f = 0; f < filesPerDirectory; ++f) {
+            std::ofstream file(directory / ("doc" + std::to_string(f) + ".txt"));
+            for (size_t i = 0, length = 200 + rng() % 800; i < length; ++i) {
+                file << "word" << static_cast<size_t>(std::pow(20000.0, uniform(rng))) << ' ';
+            }
+        }
+        // Files the crawl has to skip
+        std::ofstream(directory / "notes.md") << "not a document";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t directories = argc > 1 ? std::stoul(argv[1]) : 200;
+    size_t filesPerDirectory = 20;
+    fs::path root = "output/crawl_tree";
+
+    fs::remove_all(root);
+    generateTree(root, directories, filesPerDirectory);
+    size_t threads = std::thread::hardware_concurrency();
+
+    // List everything, then ingest
+    auto listed = std::make_shared<DocumentCollection>();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> paths;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".txt") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    IngestionEngine engine(listed, threads);
+    engine.ingest(paths);
+    std::chrono::duration<double> listThenIngest = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Tree: " << directories << " directories, " << paths.size() << " documents\n\n";
+    std::cout << std::fixed << std::setprecision(3)
+              << "list then ingest:   " << listThenIngest.count() << " s\n";
+
+    // Pipelined, with blocking reads and with io_uring batches where the kernel has it
+    bool same = true;
+    for (ReadBackend backend : { ReadBackend::Pread, ReadBackend::IoUring }) {
+        if (backend == ReadBackend::IoUring && BatchReader(ReadBackend::IoUring).getBackend() != ReadBackend::IoUring) {
+            std::cout << "pipeline, io_uring: not available\n";
+            continue;
+        }
+        auto crawled = std::make_shared<DocumentCollection>();
+        CrawlOptions options;
+        options.tokenizerThreads = threads;
+        options.readBackend = backend;
+        CrawlPipeline crawler(crawled, options);
+        size_t added = crawler.run({ root.string() });
+        std::cout << "pipeline, " << std::setw(9) << std::left << getReadBackendName(backend) << std::right
+                  << crawler.getStats().seconds << " s\n";
+        if (backend == ReadBackend::Pread) {
+            std::cout << "\n";
+            crawler.printStats();
+            std::cout << "\n";
+        }
+
+        same = same && added == paths.size() &&
+               crawled->getDocumentCount() == listed->getDocumentCount() &&
+               crawled->getVocabularySize() == listed->getVocabularySize();
+    }
+    // The read stage alone: whole files into memory, nothing else
+    std::cout << "\nReading only:\n";
+    for (ReadBackend backend : { ReadBackend::Pread, ReadBackend::IoUring }) {
+        BatchReader reader(backend, 256);
+        if (reader.getBackend() != backend) {
+            continue;
+        }
+        size_t bytes = 0;
+        auto readStart = std::chrono::steady_clock::now();
+        reader.readAll(paths, [&](std::string&, std::string& text) { bytes += text.size(); });
+        std::chrono::duration<double> readTime = std::chrono::steady_clock::now() - readStart;
+        std::cout << "  " << std::setw(9) << std::left << getReadBackendName(backend) << std::right
+                  << readTime.count() << " s, " << std::setprecision(0) << paths.size() / readTime.count()
+                  << " files/s, " << std::setprecision(1) << bytes / 1048576.0 / readTime.count() << " MB/s\n"
+                  << std::setprecision(3);
+    }
+
+    std::cout << "\nDocuments and vocabulary: " << (same ? "identical" : "DIFFER") << "\n";
+
+    fs::remove_all(root);
+    return same ? 0 : 1;
+}
@@ -1,6 +1,12 @@
+#include <chrono>
 #include <iostream>
 #include "generator.h"
 #include "tf-idf.h"
+#include "crawler.h"
+#include "index-file.h"
+#include "query.h"
+#include "similarity.h"
+#include "lsh-index.h"
 
 int main(int argc, char* argv[]) {
     std::string docDirectory = "sample_docs";
@@ -15,57 +21,101 @@ int main(int argc, char* argv[]) {
         std::cout << "\n";
     }
     
-    // Collect all text files
-    std::vector<std::string> filePaths;
-    for (const auto& entry : fs::directory_iterator(docDirectory)) {
-        std::cout << "Found: " << entry.path() << " (ext: " << entry.path().extension() << ")\n";
-        if (entry.path().extension() == ".txt") {
-            filePaths.push_back(entry.path().string());
-        }
-    }
+    // Crawl the directory tree: listing, reads and tokenizing overlap in a pipeline,
+    // and every document is sketched for LSH
+    auto collection = std::make_shared<DocumentCollection>();
+    CrawlOptions crawlOptions;
+    crawlOptions.processing.minHash = true;
+    CrawlPipeline crawler(collection, crawlOptions);
     
-    if (filePaths.empty()) {
-        std::cerr << "Error: No .txt files found in " << docDirectory << "\n";
+    std::cout << "Crawling " << docDirectory << "...\n\n";
+    if (crawler.run({ docDirectory }) == 0) {
+        uint64_t skipped = crawler.getStats().skipped;
+        if (skipped > 0) {
+            std::cerr << "Error: No documents added from " << docDirectory << ", "
+                      << skipped << " files or directories could not be read\n";
+        } else {
+            std::cerr << "Error: No .txt files found in " << docDirectory << "\n";
+        }
         return 1;
     }
+    crawler.printStats();
     
-    std::cout << "Found " << filePaths.size() << " documents\n";
-    std::cout << "Processing with " << std::thread::hardware_concurrency() 
-              << " threads...\n\n";
-    
-    // Create shared collection
-    auto collection = std::make_shared<DocumentCollection>();
+    std::cout << "\nProcessed " << collection->getDocumentCount() << " documents\n";
+    std::cout << "Vocabulary size: " << collection->getVocabularySize() << " unique terms\n";
     
-    // Process documents in parallel
-    std::vector<std::thread> threads;
-    std::vector<std::unique_ptr<DocumentProcessor>> processors;
+    auto contention = collection->getContentionStats();
+    std::cout << "Collection locks: " << contention.acquisitions << " acquisitions, "
+              << contention.contended << " contended, "
+              << contention.waitNanos / 1000 << " us waited\n\n";
     
-    for (const auto& path : filePaths) {
-        processors.push_back(std::make_unique<DocumentProcessor>(path, collection));
-    }
-    
-    for (auto& processor : processors) {
-        threads.emplace_back([&processor]() {
-            processor->process();
-        });
-    }
-    
-    // Wait for all processing to complete
-    for (auto& t : threads) {
-        t.join();
-    }
-    
-    std::cout << "Processed " << collection->getDocumentCount() << " documents\n";
-    std::cout << "Vocabulary size: " << collection->getVocabulary().size() << " unique terms\n\n";
+    // Workers for the parallel TF-IDF, export and similarity phases
+    ThreadPool pool(std::thread::hardware_concurrency());
     
     // Compute TF-IDF matrix
     TFIDFMatrix tfidf(collection);
-    tfidf.compute();
+    tfidf.compute(&pool);
     
     // Display results
     tfidf.printTopTermsPerDocument(10);
     tfidf.printMatrix(15);
     tfidf.exportToCSV("output/tfidf_matrix.csv");
     
+    ExportOptions sparseExport;
+    sparseExport.layout = ExportOptions::Layout::Triplets;
+    sparseExport.delimiter = '\t';
+    sparseExport.pool = &pool;
+    tfidf.exportToCSV("output/tfidf_triplets.tsv", sparseExport);
+    
+    // Closely related documents, all pairs at once
+    SimilarityEngine similarity(tfidf);
+    std::cout << "\n=== Similar Documents (cosine >= 0.05) ===\n";
+    for (const auto& pair : similarity.findSimilarPairs(0.05, &pool)) {
+        std::cout << "  " << std::setw(20) << std::left << tfidf.getDocumentName(pair.first)
+                  << std::setw(20) << tfidf.getDocumentName(pair.second)
+                  << std::right << std::setprecision(4) << pair.score << "\n";
+    }
+    
+    // Near-duplicate candidates without comparing every pair
+    LSHIndex lsh;
+    lsh.addCollection(*collection);
+    LSHPairStats lshStats;
+    auto candidates = lsh.getCandidatePairs(0.0, &pool, &lshStats);
+    std::cout << "\nLSH candidates (Jaccard threshold ~" << std::setprecision(2) << lsh.getThreshold()
+              << "): " << candidates.size() << " pairs";
+    if (lshStats.droppedPairs > 0) {
+        std::cout << ", " << lshStats.droppedPairs << " dropped from " << lshStats.oversizedBuckets
+                  << " oversized buckets";
+    }
+    std::cout << "\n";
+    for (const auto& pair : candidates) {
+        std::cout << "  " << std::setw(20) << std::left << tfidf.getDocumentName(pair.first)
+                  << std::setw(20) << tfidf.getDocumentName(pair.second)
+                  << std::right << std::setprecision(4) << pair.score << "\n";
+    }
+    
+    // Persist the index and map it back in, as a restarted service would
+    tfidf.saveIndex("output/tfidf.idx");
+    auto loadStart = std::chrono::steady_clock::now();
+    IndexFile index("output/tfidf.idx");
+    std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - loadStart;
+    if (index.isOpen()) {
+        std::cout << "Reopened index: " << index.getTermCount() << " terms, "
+                  << index.getDocumentCount() << " documents, "
+                  << index.getNonZeros() << " postings in "
+                  << std::fixed << std::setprecision(3) << loadTime.count() << " ms\n";
+        
+        // Ranked queries straight off the mapped index
+        QueryEngine engine(index);
+        std::cout << "\n=== Search ===\n";
+        for (const char* query : { "neural network training", "sql query optimization", "docker kubernetes" }) {
+            std::cout << "\nQuery: \"" << query << "\"\n";
+            for (const auto& result : engine.search(query, 3)) {
+                std::cout << "  " << std::setw(20) << std::left << index.getDocumentName(result.doc)
+                          << std::right << std::setprecision(4) << result.score << "\n";
+            }
+        }
+    }
+    
     return 0;
 }
\ No newline at end of file
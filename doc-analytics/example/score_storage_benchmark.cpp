@@ -0,0 +1,233 @@
+/**
+ * Score Storage Benchmark
+ *
+ * Ranks the same queries over double postings and over each compact score
+ * storage (float32, 16-bit and 8-bit quantized), and reports value memory,
+ * query time and ranking quality against double precision: the share of the
+ * double top-10 that is still returned, and the largest score difference.
+ * The matrix itself is then built in each storage to compare its memory.
+ * Document ids are then compressed (delta + bit-packed blocks), checked to
+ * rank exactly like plain ids, and every list is decoded in full to measure id
+ * throughput against reading plain ids. The 8-bit mode with packed ids is also written to
+ * disk and reopened to check the index format.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include "tf-idf.h"
+#include "compact-postings.h"
+#include "index-file.h"
+#include "query.h"
+
+// Zipf-like term counts over a fixed vocabulary
+std::shared_ptr<DocumentCollection> generateCollection(size_t documents, size_t vocabulary) {
+    auto collection = std::make_shared<DocumentCollection>();
+    TermDictionary& dictionary = collection->getDictionary();
+    for (size_t t = 0; t < vocabulary; ++t) {
+        dictionary.intern("term" + std::to_string(t));
+    }
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (size_t d = 0; d < documents; ++d) {
+        DocumentStats doc;
+        doc.docName = "doc" + std::to_string(d) + ".txt";
+        size_t length = 100 + rng() % 900;
+        std::map<TermId, int> counts;
+        for (size_t i = 0; i < length; ++i) {
+            TermId term = static_cast<TermId>(std::pow(vocabulary, uniform(rng))) - 1;
+            counts[term]++;
+        }
+        for (const auto& [term, count] : counts) {
+            doc.termFrequency.push_back({ term, count });
+        }
+        doc.totalTerms = length;
+        collection->addDocument(doc);
+    }
+    return collection;
+}
+
+using Rankings = std::vector<std::vector<SearchResult>>;
+
+Rankings runQueries(const PostingsSource& source, const std::vector<std::string>& queries,
+                    size_t k, double& seconds) {
+    QueryEngine engine(source);
+    Rankings rankings;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& query : queries) {
+        rankings.push_back(engine.search(query, k));
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    seconds = elapsed.count();
+    return rankings;
+}
+
+// Reads every document id of every postings list, best of three passes; returns ids
+// per second and a checksum so the decoding cannot be optimized away
+std::pair<double, uint64_t> decodeAllIds(const PostingsSource& source) {
+    double best = 0;
+    uint64_t checksum = 0;
+    for (int pass = 0; pass < 3; ++pass) {
+        uint64_t ids = 0;
+        checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (TermId term = 0; term < source.getTermCount(); ++term) {
+            PostingsList list = source.getPostings(term);
+            forEachDocBlock(list.docs, list.packedDocs, list.size, [&](const uint32_t* docs, size_t, size_t n) {
+                for (size_t i = 0; i < n; ++i) {
+                    checksum += docs[i];
+                }
+                ids += n;
+            });
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::max(best, ids / std::max(elapsed.count(), 1e-9));
+    }
+    return { best, checksum };
+}
+
+// Share of the reference hits that are also returned, and the largest score difference
+std::pair<double, double> compareRankings(const Rankings& reference, const Rankings& other) {
+    size_t expected = 0, found = 0;
+    double maxError = 0;
+    for (size_t q = 0; q < reference.size(); ++q) {
+        for (const auto& hit : reference[q]) {
+            expected++;
+            auto it = std::find_if(other[q].begin(), other[q].end(),
+                [&](const SearchResult& result) { return result.doc == hit.doc; });
+            if (it != other[q].end()) {
+                found++;
+                maxError = std::max(maxError, std::abs(it->score - hit.score));
+            }
+        }
+    }
+    return { expected ? static_cast<double>(found) / expected : 1.0, maxError };
+}
+
+int main(int argc, char* argv[]) {
+    size_t documents = argc > 1 ? std::stoul(argv[1]) : 20000;
+    size_t vocabulary = 50000;
+    size_t k = 10;
+    auto collection = generateCollection(documents, vocabulary);
+
+    TFIDFMatrix matrix(collection);
+    std::streambuf* console = std::cout.rdbuf(nullptr);
+    matrix.compute();
+    std::cout.rdbuf(console);
+    std::cout.clear();
+
+    // Three to five terms of mid to low frequency per query
+    std::mt19937 rng(5);
+    std::vector<std::string> queries;
+    for (int q = 0; q < 500; ++q) {
+        std::string query;
+        for (size_t t = 0, count = 3 + rng() % 3; t < count; ++t) {
+            query += "term" + std::to_string(10 + rng() % 5000) + " ";
+        }
+        queries.push_back(query);
+    }
+
+    size_t postings = 0;
+    for (TermId term = 0; term < matrix.getTermCount(); ++term) {
+        postings += matrix.getPostings(term).size;
+    }
+
+    double seconds = 0;
+    Rankings reference = runQueries(matrix, queries, k, seconds);
+    size_t doubleBytes = postings * sizeof(double);
+    std::cout << "Corpus: " << documents << " documents, " << postings << " postings, "
+              << queries.size() << " queries, top " << k << "\n\n";
+    std::cout << std::left << std::setw(14) << "storage" << std::setw(14) << "value MB"
+              << std::setw(14) << "us/query" << std::setw(12) << "top-k kept%" << "max score error\n";
+    std::cout << std::setw(14) << "double" << std::fixed << std::setprecision(1)
+              << std::setw(14) << doubleBytes / 1048576.0
+              << std::setw(14) << seconds * 1e6 / queries.size()
+              << std::setw(12) << 100.0 << "0\n";
+
+    // Minimum share of the double top-k each mode has to keep
+    const std::pair<ScoreStorage, double> modes[] = {
+        { ScoreStorage::Float32, 0.999 },
+        { ScoreStorage::Quantized16, 0.99 },
+        { ScoreStorage::Quantized8, 0.9 },
+    };
+    bool passed = true;
+    for (const auto& [storage, minimum] : modes) {
+        CompactPostings compact(matrix, storage);
+        Rankings rankings = runQueries(compact, queries, k, seconds);
+        auto [kept, maxError] = compareRankings(reference, rankings);
+        passed = passed && kept >= minimum;
+        std::cout << std::setw(14) << getScoreStorageName(storage) << std::setprecision(1)
+                  << std::setw(14) << compact.getValueBytes() / 1048576.0
+                  << std::setw(14) << seconds * 1e6 / queries.size()
+                  << std::setw(12) << kept * 100
+                  << std::scientific << std::setprecision(2) << maxError << std::fixed
+                  << (kept >= minimum ? "" : "  BELOW TARGET") << "\n";
+    }
+
+    // The matrix can hold its own values compactly: both score copies shrink
+    std::cout << "\n" << std::setw(14) << "matrix" << std::setw(14) << "matrix MB"
+              << std::setw(14) << "us/query" << "top-k kept%\n";
+    std::cout << std::setw(14) << "double" << std::setprecision(1)
+              << std::setw(14) << matrix.getStorageBytes() / 1048576.0 << "\n";
+    for (const auto& [storage, minimum] : modes) {
+        TFIDFMatrix stored(collection, ClassicTFIDF(), storage);
+        std::cout.rdbuf(nullptr);
+        stored.compute();
+        std::cout.rdbuf(console);
+        std::cout.clear();
+        Rankings rankings = runQueries(stored, queries, k, seconds);
+        double kept = compareRankings(reference, rankings).first;
+        passed = passed && kept >= minimum;
+        std::cout << std::setw(14) << getScoreStorageName(storage) << std::setprecision(1)
+                  << std::setw(14) << stored.getStorageBytes() / 1048576.0
+                  << std::setw(14) << seconds * 1e6 / queries.size()
+                  << kept * 100 << (kept >= minimum ? "" : "  BELOW TARGET") << "\n";
+    }
+
+    // Compressed document ids only change the layout, never the ranking
+    std::cout << "\n" << std::setw(14) << "doc ids" << std::setw(14) << "id MB"
+              << std::setw(14) << "us/query" << std::setw(14) << "M ids/s" << "rankings\n";
+    CompactPostings plainIds(matrix, ScoreStorage::Quantized8);
+    CompactPostings packedIds(matrix, ScoreStorage::Quantized8, DocIdEncoding::Packed);
+    Rankings plainRankings = runQueries(plainIds, queries, k, seconds);
+    auto [plainRate, plainChecksum] = decodeAllIds(plainIds);
+    std::cout << std::setw(14) << "plain" << std::setprecision(1)
+              << std::setw(14) << plainIds.getDocIdBytes() / 1048576.0
+              << std::setw(14) << seconds * 1e6 / queries.size()
+              << std::setw(14) << plainRate / 1e6 << "\n";
+    Rankings packedRankings = runQueries(packedIds, queries, k, seconds);
+    auto [packedRate, packedChecksum] = decodeAllIds(packedIds);
+    auto [packedKept, packedError] = compareRankings(plainRankings, packedRankings);
+    bool packedSame = packedKept == 1.0 && packedError == 0 && packedChecksum == plainChecksum;
+    passed = passed && packedSame;
+    std::cout << std::setw(14) << "packed"
+              << std::setw(14) << packedIds.getDocIdBytes() / 1048576.0
+              << std::setw(14) << seconds * 1e6 / queries.size()
+              << std::setw(14) << packedRate / 1e6
+              << (packedSame ? "identical" : "DIFFER") << "  ("
+              << std::setprecision(2) << static_cast<double>(plainIds.getDocIdBytes()) / packedIds.getDocIdBytes()
+              << "x smaller)\n";
+
+    // The on-disk form has to rank exactly like the in-memory one
+    std::cout.rdbuf(nullptr);
+    bool saved = matrix.saveIndex("output/score_storage.idx", ScoreStorage::Quantized8, DocIdEncoding::Packed);
+    std::cout.rdbuf(console);
+    std::cout.clear();
+    IndexFile index("output/score_storage.idx");
+    if (saved && index.isOpen()) {
+        Rankings onDisk = runQueries(index, queries, k, seconds);
+        auto [kept, maxError] = compareRankings(packedRankings, onDisk);
+        bool same = kept == 1.0 && maxError == 0;
+        passed = passed && same;
+        std::cout << "\nquantized8 + packed ids index file: " << (same ? "identical" : "DIFFERS") << " to in-memory\n";
+    } else {
+        passed = false;
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+/**
+ * Tokenizer Micro-benchmark
+ *
+ * Compares the original istringstream + cleanWord tokenization with every
+ * scan kernel supported by this CPU, checks that all of them produce the same
+ * term counts and reports throughput in GB/s.
+ */
+
+#include <chrono>
+#include <cctype>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "tokenizer.h"
+
+using TermCounts = std::map<std::string, int>;
+
+// The pre-tokenizer path, kept here as the reference implementation
+std::string cleanWord(const std::string& word) {
+    std::string cleaned;
+    for (char c : word) {
+        if (std::isalnum(c)) {
+            cleaned += std::tolower(c);
+        }
+    }
+    return cleaned;
+}
+
+TermCounts referenceCounts(const std::string& text) {
+    TermCounts counts;
+    std::istringstream lines(text);
+    std::string line, word;
+    while (std::getline(lines, line)) {
+        std::istringstream iss(line);
+        while (iss >> word) {
+            std::string cleaned = cleanWord(word);
+            if (cleaned.length() > 2) {
+                counts[cleaned]++;
+            }
+        }
+    }
+    return counts;
+}
+
+TermCounts tokenizerCounts(const std::string& text, ScanKernel kernel) {
+    TermCounts counts;
+    Tokenizer tokenizer(kernel);
+    tokenizer.tokenize(text, [&](std::string_view term) {
+        if (term.length() > 2) {
+            counts[std::string(term)]++;
+        }
+    });
+    return counts;
+}
+
+// Mostly plain lowercase words, with capitals, punctuation and mixed separators
+std::string generateCorpus(size_t bytes) {
+    std::vector<std::string> words = {
+        "data", "index", "query", "network", "the", "and", "Algorithm", "Kernel",
+        "thread,", "memory.", "don't", "e-mail", "HTTP", "x", "of", "2024",
+        "compression", "tokenization", "(optimization)", "caf\xc3\xa9"
+    };
+    const char* separators[] = { " ", " ", " ", " ", "\n", "\t", "  ", "\r\n" };
+
+    std::mt19937 rng(42);
+    std::string text;
+    text.reserve(bytes + 32);
+    while (text.size() < bytes) {
+        text += words[rng() % words.size()];
+        text += separators[rng() % 8];
+    }
+    return text;
+}
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 64;
+    int repetitions = 5;
+    std::string text = generateCorpus(megabytes << 20);
+
+    std::cout << "Corpus: " << megabytes << " MB, best of " << repetitions << " runs\n\n";
+
+    auto measure = [&](auto&& run) {
+        double best = 1e30;
+        for (int r = 0; r < repetitions; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return text.size() / best / 1e9;
+    };
+
+    TermCounts reference = referenceCounts(text);
+    double referenceSpeed = measure([&]() { referenceCounts(text); });
+    std::cout << std::left << std::setw(22) << "istringstream+clean"
+              << std::fixed << std::setprecision(3) << referenceSpeed << " GB/s\n";
+
+    bool identical = true;
+    for (ScanKernel kernel : { ScanKernel::Scalar, ScanKernel::SSE2, ScanKernel::AVX2 }) {
+        if (!isScanKernelSupported(kernel)) {
+            std::cout << std::setw(22) << getScanKernelName(kernel) << "not supported\n";
+            continue;
+        }
+
+        bool same = tokenizerCounts(text, kernel) == reference;
+        identical = identical && same;
+
+        // Time the scan itself: count tokens without building a map
+        size_t tokens = 0;
+        Tokenizer tokenizer(kernel);
+        double speed = measure([&]() {
+            tokens = 0;
+            tokenizer.tokenize(text, [&](std::string_view term) { tokens += term.length() > 2; });
+        });
+
+        std::cout << std::setw(22) << getScanKernelName(kernel)
+                  << std::setprecision(3) << speed << " GB/s  ("
+                  << std::setprecision(1) << speed / referenceSpeed << "x, "
+                  << tokens << " terms, counts " << (same ? "identical" : "DIFFER") << ")\n";
+    }
+
+    return identical ? 0 : 1;
+}
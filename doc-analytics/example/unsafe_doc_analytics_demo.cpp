@@ -22,9 +22,16 @@
 
 namespace fs = std::filesystem;
 
+// Plain string-keyed stats, without the shared term dictionary
+struct UnsafeDocumentStats {
+    std::string docName;
+    std::map<std::string, int> termFrequency;
+    int totalTerms = 0;
+};
+
 class UnsafeDocumentCollection {
 private:
-    std::vector<DocumentStats*> documents;  // Raw pointers - manual management
+    std::vector<UnsafeDocumentStats*> documents;  // Raw pointers - manual management
     std::set<std::string> vocabulary;
     
 public:
@@ -34,7 +41,7 @@ public:
         }
     }
     
-    void addDocument(DocumentStats* doc) {
+    void addDocument(UnsafeDocumentStats* doc) {
         // Race condition
         documents.push_back(doc);
         
@@ -75,7 +82,7 @@ public:
         }
         
         // Manual memory management - must remember to delete
-        DocumentStats* docStats = new DocumentStats();
+        UnsafeDocumentStats* docStats = new UnsafeDocumentStats();
         docStats->docName = fs::path(filepath).filename().string();
         
         std::string line, word;
@@ -0,0 +1,126 @@
+/**
+ * Weighting Scheme Benchmark
+ *
+ * Times the TF and IDF scoring passes of the default scheme against the fixed
+ * count / length and log(N / df) formulas they replace, checks that both give the
+ * same values, then times a full TFIDFMatrix::compute() under each built-in scheme.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include "tf-idf.h"
+
+// Zipf-like term counts over a fixed vocabulary
+std::shared_ptr<DocumentCollection> generateCollection(size_t documents, size_t vocabulary) {
+    auto collection = std::make_shared<DocumentCollection>();
+    TermDictionary& dictionary = collection->getDictionary();
+    for (size_t t = 0; t < vocabulary; ++t) {
+        dictionary.intern("term" + std::to_string(t));
+    }
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (size_t d = 0; d < documents; ++d) {
+        DocumentStats doc;
+        doc.docName = "doc" + std::to_string(d) + ".txt";
+        size_t length = 200 + rng() % 800;
+        std::map<TermId, int> counts;
+        for (size_t i = 0; i < length; ++i) {
+            TermId term = static_cast<TermId>(std::pow(vocabulary, uniform(rng))) - 1;
+            counts[term]++;
+        }
+        for (const auto& [term, count] : counts) {
+            doc.termFrequency.push_back({ term, count });
+        }
+        doc.totalTerms = length;
+        collection->addDocument(doc);
+    }
+    return collection;
+}
+
+int main(int argc, char* argv[]) {
+    size_t documents = argc > 1 ? std::stoul(argv[1]) : 20000;
+    size_t vocabulary = 50000;
+    int repetitions = 5;
+    auto collection = generateCollection(documents, vocabulary);
+    std::vector<DocumentView> docs;
+    size_t cells = 0;
+    for (DocId docId = 0; docId < collection->getSlotCount(); ++docId) {
+        docs.push_back(collection->getDocument(docId));
+        cells += docs.back().termFrequency.size();
+    }
+    std::cout << "Corpus: " << documents << " documents, " << cells << " non-zeros, best of "
+              << repetitions << " runs\n\n";
+
+    auto measure = [&](auto&& run) {
+        double best = 1e30;
+        for (int r = 0; r < repetitions; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    };
+
+    // Scoring passes only: fixed formulas inline versus the scheme behind its adapter
+    std::vector<TermId> fixedTerms(cells);
+    std::vector<double> fixedTF(cells), fixedIDF(vocabulary);
+    double fixedTime = measure([&]() {
+        size_t pos = 0;
+        for (const auto& doc : docs) {
+            for (const auto& [term, freq] : doc.termFrequency) {
+                fixedTerms[pos] = term;
+                fixedTF[pos++] = static_cast<double>(freq) / doc.totalTerms;
+            }
+        }
+        int totalDocs = collection->getDocumentCount();
+        for (TermId term = 0; term < vocabulary; ++term) {
+            int docFreq = collection->getDocumentFrequency(term);
+            fixedIDF[term] = docFreq > 0 ? std::log(static_cast<double>(totalDocs) / docFreq) : 0.0;
+        }
+    });
+
+    WeightingAdapter<ClassicTFIDF> classic{ ClassicTFIDF() };
+    const Weighting& weighting = classic;
+    CorpusShape corpus;
+    corpus.documents = collection->getDocumentCount();
+    std::vector<TermId> schemeTerms(cells);
+    std::vector<double> schemeTF(cells), schemeIDF(vocabulary);
+    double schemeTime = measure([&]() {
+        size_t pos = 0;
+        for (const auto& doc : docs) {
+            weighting.scoreDocument(doc, corpus, &schemeTerms[pos], &schemeTF[pos]);
+            pos += doc.termFrequency.size();
+        }
+        weighting.scoreTerms(*collection, nullptr, schemeIDF);
+    });
+
+    bool identical = fixedTerms == schemeTerms && fixedTF == schemeTF && fixedIDF == schemeIDF;
+    std::cout << std::left << std::setw(24) << "fixed formula"
+              << std::fixed << std::setprecision(2) << fixedTime * 1e9 / cells << " ns/cell\n";
+    std::cout << std::setw(24) << "ClassicTFIDF policy"
+              << schemeTime * 1e9 / cells << " ns/cell  ("
+              << std::setprecision(3) << fixedTime / schemeTime << "x, values "
+              << (identical ? "identical" : "DIFFER") << ")\n\n";
+
+    // Whole matrix builds; compute() prints progress, which is silenced meanwhile
+    auto computeTime = [&](const char* name, auto scheme) {
+        TFIDFMatrix matrix(collection, scheme);
+        std::streambuf* console = std::cout.rdbuf(nullptr);
+        double seconds = measure([&]() { matrix.compute(); });
+        std::cout.rdbuf(console);
+        std::cout.clear();
+        std::cout << std::setw(24) << name << std::setprecision(1) << seconds * 1e3 << " ms compute()\n";
+    };
+    computeTime("ClassicTFIDF", ClassicTFIDF());
+    computeTime("SublinearTFIDF", SublinearTFIDF());
+    computeTime("BM25Weighting", BM25Weighting());
+    computeTime("Augmented/Prob./L2", WeightingScheme<AugmentedTF, ProbabilisticIDF, L2Normalization>());
+
+    return identical ? 0 : 1;
+}
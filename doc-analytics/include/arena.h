@@ -0,0 +1,60 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Bump allocator for short-lived bytes, such as the keys of one document's term
+// counts. Nothing is freed individually: reset() rewinds to the first block and
+// keeps every block, so once the arena has grown to a worker's largest document
+// it serves the following ones without touching the heap.
+class Arena {
+private:
+    static constexpr size_t BLOCK_SIZE = 64 << 10;
+
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0; // block being filled
+    size_t used = 0;    // bytes taken from it
+
+public:
+    Arena() = default;
+    Arena(Arena&&) = default;
+    Arena& operator=(Arena&&) = default;
+
+    char* allocate(size_t size) {
+        while (current < blocks.size() && used + size > blocks[current].size) {
+            current++;
+            used = 0;
+        }
+        if (current == blocks.size()) {
+            blocks.push_back({ std::make_unique<char[]>(std::max(size, BLOCK_SIZE)), std::max(size, BLOCK_SIZE) });
+            used = 0;
+        }
+        char* result = blocks[current].data.get() + used;
+        used += size;
+        return result;
+    }
+
+    std::string_view copy(std::string_view text) {
+        char* data = allocate(text.size());
+        std::memcpy(data, text.data(), text.size());
+        return std::string_view(data, text.size());
+    }
+
+    // Everything handed out so far becomes invalid
+    void reset() {
+        current = 0;
+        used = 0;
+    }
+};
+
+#endif // ARENA_H_
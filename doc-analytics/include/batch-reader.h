@@ -0,0 +1,80 @@
+#ifndef BATCH_READER_H_
+#define BATCH_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// How BatchReader issues its reads. Auto is Pread: on a warm page cache blocking
+// reads beat io_uring batches (crawl_benchmark), so io_uring is only used when
+// asked for, and falls back to Pread where the kernel lacks it.
+enum class ReadBackend { Auto, IoUring, Pread };
+
+const char* getReadBackendName(ReadBackend backend);
+
+// Reads whole files with many of them in flight at once. With io_uring, opens, reads
+// and closes of up to `depth` files are queued together and handed to the kernel
+// with one system call per batch. Files are read into a buffer of 16 KB that
+// doubles while reads fill it, until a read returns nothing, so a small file takes
+// two reads and no stat. One read asks for at most 0x7ffff000 bytes, the most
+// Linux transfers at once, so larger files are read in several.
+// The Pread backend does the same work with blocking calls, one file at a time.
+//
+// Finished files come back in completion order, not submission order.
+// One reader is used by one thread.
+class BatchReader {
+public:
+    // Called with each file's path and whole contents; both may be moved from
+    using Callback = std::function<void(std::string& path, std::string& text)>;
+
+private:
+    struct Ring;
+    struct Slot;
+
+    ReadBackend backend;
+    size_t depth;
+    std::unique_ptr<Ring> ring;        // io_uring only
+    std::vector<Slot> slots;           // [depth], one per file in flight
+    std::vector<size_t> freeSlots;
+    std::vector<std::string> pending;  // Pread only: submitted, not yet read
+    uint64_t failed = 0;
+
+    void queueOpen(size_t slot);
+    // Queues the next read of a file; false when its buffer cannot grow
+    bool queueRead(size_t slot);
+    void queueClose(int fd);
+    void finish(size_t slot, const Callback& onFile);
+    size_t completeRing(const Callback& onFile, bool wait);
+    // Handles the completions already in the ring
+    size_t reapRing(const Callback& onFile);
+    size_t completePread(const Callback& onFile);
+
+public:
+    explicit BatchReader(ReadBackend readBackend = ReadBackend::Auto, size_t maxInFlight = 256);
+    ~BatchReader();
+
+    BatchReader(const BatchReader&) = delete;
+    BatchReader& operator=(const BatchReader&) = delete;
+
+    // The backend actually in use (never Auto)
+    ReadBackend getBackend() const { return backend; }
+    size_t getDepth() const { return depth; }
+    size_t getInFlight() const;
+    bool isFull() const { return getInFlight() >= depth; }
+    bool isIdle() const { return getInFlight() == 0; }
+    // Files that could not be opened or read; each also printed a warning
+    uint64_t getFailedCount() const { return failed; }
+
+    // Queues a file; call only while !isFull()
+    void submit(std::string path);
+    // Reports finished files to onFile and returns how many finished. With `wait`,
+    // blocks until at least one file is done if any is in flight.
+    size_t complete(const Callback& onFile, bool wait = true);
+    // Reads every path, keeping the reader full
+    void readAll(const std::vector<std::string>& paths, const Callback& onFile);
+};
+
+#endif // BATCH_READER_H_
@@ -0,0 +1,150 @@
+#ifndef BOUNDED_QUEUE_H_
+#define BOUNDED_QUEUE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// Occupancy and wait times of a BoundedQueue
+struct QueueStats {
+    size_t capacity = 0;
+    size_t peak = 0;            // most items held at once
+    size_t byteCapacity = 0;    // 0 when only items are limited
+    size_t peakBytes = 0;
+    uint64_t pushWaitNanos = 0; // producers blocked on a full queue
+    uint64_t popWaitNanos = 0;  // consumers blocked on an empty queue
+};
+
+// Multi-producer, multi-consumer FIFO of at most `capacity` items and, when
+// `byteCapacity` is set, of at most that many bytes as declared by push(); an item
+// larger than that still passes once the queue holds no bytes. A full queue blocks
+// its producers, which is how a slow stage throttles the ones before it.
+// Time spent blocked is counted on both sides, only when a caller actually waits.
+template <typename T>
+class BoundedQueue {
+private:
+    struct Entry {
+        T item;
+        size_t bytes;
+    };
+
+    mutable std::mutex mtx;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<Entry> items;
+    size_t capacity;
+    size_t byteCapacity;
+    size_t bytes = 0;
+    size_t peak = 0;
+    size_t peakBytes = 0;
+    bool closed = false;
+    uint64_t pushWaitNanos = 0;
+    uint64_t popWaitNanos = 0;
+
+    // Moves the front item out; called with the lock held
+    void take(T& item) {
+        item = std::move(items.front().item);
+        bytes -= items.front().bytes;
+        items.pop_front();
+    }
+
+    // Under a byte limit a later producer's smaller item may fit where the first one's
+    // does not, so all of them recheck
+    void wakeProducers() {
+        if (byteCapacity > 0) {
+            notFull.notify_all();
+        } else {
+            notFull.notify_one();
+        }
+    }
+
+    static uint64_t since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+public:
+    explicit BoundedQueue(size_t maxItems, size_t maxBytes = 0)
+        : capacity(maxItems > 0 ? maxItems : 1), byteCapacity(maxBytes) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Blocks while the queue is full; returns false (dropping the item) once closed
+    bool push(T item, size_t itemBytes = 0) {
+        std::unique_lock<std::mutex> lock(mtx);
+        auto hasRoom = [&]() {
+            return items.size() < capacity &&
+                   (byteCapacity == 0 || bytes == 0 || bytes + itemBytes <= byteCapacity);
+        };
+        if (!hasRoom() && !closed) {
+            auto start = std::chrono::steady_clock::now();
+            notFull.wait(lock, [&]() { return hasRoom() || closed; });
+            pushWaitNanos += since(start);
+        }
+        if (closed) {
+            return false;
+        }
+        items.push_back({ std::move(item), itemBytes });
+        bytes += itemBytes;
+        peak = std::max(peak, items.size());
+        peakBytes = std::max(peakBytes, bytes);
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks while the queue is empty; returns false once it is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (items.empty() && !closed) {
+            auto start = std::chrono::steady_clock::now();
+            notEmpty.wait(lock, [this]() { return !items.empty() || closed; });
+            popWaitNanos += since(start);
+        }
+        if (items.empty()) {
+            return false;
+        }
+        take(item);
+        lock.unlock();
+        wakeProducers();
+        return true;
+    }
+
+    // Takes an item only if one is queued right now
+    bool tryPop(T& item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (items.empty()) {
+            return false;
+        }
+        take(item);
+        lock.unlock();
+        wakeProducers();
+        return true;
+    }
+
+    // No more pushes; consumers still drain what is queued
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            closed = true;
+        }
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return items.size();
+    }
+
+    QueueStats snapshot() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return { capacity, peak, byteCapacity, peakBytes, pushWaitNanos, popWaitNanos };
+    }
+};
+
+#endif // BOUNDED_QUEUE_H_
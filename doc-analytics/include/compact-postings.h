@@ -0,0 +1,47 @@
+#ifndef COMPACT_POSTINGS_H_
+#define COMPACT_POSTINGS_H_
+
+#include <vector>
+#include "postings-source.h"
+#include "score-matrix.h"
+
+// In-memory copy of the postings of another source with the values re-encoded as
+// float32 or 16/8-bit integers with a per-term scale: 2x, 4x or 8x less value
+// memory than doubles, and proportionally fewer cache lines per scored list.
+// Document ids can be compressed too (DocIdEncoding::Packed).
+// Term lookup, document names and IDF are copied as well, so the source can be
+// released once this is built.
+class CompactPostings : public PostingsSource {
+private:
+    ScoreStorage storage;
+    DocIdEncoding docIdEncoding;
+    std::vector<uint64_t> offsets;     // termCount + 1 CSR row offsets
+    std::vector<uint64_t> docOffsets;  // termCount + 1 word offsets into docs
+    std::vector<uint32_t> docs;        // plain ids, or one compressed list per term
+    std::vector<unsigned char> values; // encoded, getScoreSize(storage) bytes each
+    std::vector<double> scales;        // [term]
+    mutable TermDictionary terms;      // same ids as the source; find() locks a shard
+    std::vector<double> idf;           // [term]
+    std::vector<uint64_t> nameOffsets; // documentCount + 1 offsets into names
+    std::vector<char> names;
+
+public:
+    CompactPostings(const PostingsSource& source, ScoreStorage scoreStorage,
+                    DocIdEncoding docEncoding = DocIdEncoding::Plain);
+
+    // Bytes taken by the encoded values and by the document ids
+    size_t getValueBytes() const { return values.size(); }
+    size_t getDocIdBytes() const { return docs.size() * sizeof(uint32_t); }
+
+    size_t getTermCount() const override { return idf.size(); }
+    size_t getDocumentCount() const override { return nameOffsets.size() - 1; }
+    std::optional<TermId> findTerm(std::string_view term) const override;
+    std::string_view getTerm(TermId term) const override;
+    unsigned getHashBits() const override { return terms.getHashBits(); }
+    std::string_view getDocumentName(DocId doc) const override;
+    double getIDF(TermId term) const override { return idf[term]; }
+    ScoreStorage getScoreStorage() const override { return storage; }
+    PostingsList getPostings(TermId term) const override;
+};
+
+#endif // COMPACT_POSTINGS_H_
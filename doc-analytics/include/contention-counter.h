@@ -0,0 +1,55 @@
+#ifndef CONTENTION_COUNTER_H_
+#define CONTENTION_COUNTER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Counts lock acquisitions on a group of mutexes and how long callers waited
+// for the ones that were already held. Uncontended acquisitions cost one try_lock.
+class ContentionCounter {
+private:
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> waitNanos{0};
+
+public:
+    struct Snapshot {
+        uint64_t acquisitions = 0;
+        uint64_t contended = 0;
+        uint64_t waitNanos = 0;
+    };
+
+    template <typename Mutex>
+    std::unique_lock<Mutex> lock(Mutex& mtx) {
+        acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+        std::unique_lock<Mutex> guard(mtx, std::try_to_lock);
+        if (!guard.owns_lock()) {
+            auto start = std::chrono::steady_clock::now();
+            guard.lock();
+            auto waited = std::chrono::steady_clock::now() - start;
+
+            contended.fetch_add(1, std::memory_order_relaxed);
+            waitNanos.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(),
+                std::memory_order_relaxed);
+        }
+        return guard;
+    }
+
+    Snapshot snapshot() const {
+        return { acquisitions.load(std::memory_order_relaxed),
+                 contended.load(std::memory_order_relaxed),
+                 waitNanos.load(std::memory_order_relaxed) };
+    }
+
+    void reset() {
+        acquisitions.store(0, std::memory_order_relaxed);
+        contended.store(0, std::memory_order_relaxed);
+        waitNanos.store(0, std::memory_order_relaxed);
+    }
+};
+
+#endif // CONTENTION_COUNTER_H_
@@ -0,0 +1,124 @@
+#ifndef CRAWLER_H_
+#define CRAWLER_H_
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "batch-reader.h"
+#include "bounded-queue.h"
+#include "tf-idf.h"
+
+struct CrawlOptions {
+    std::vector<std::string> extensions{".txt"}; // files to ingest; empty takes every regular file
+    bool recursive = true;                       // descend into subdirectories (symlinked ones are skipped)
+    size_t discoveryThreads = 4;                 // directories listed concurrently
+    size_t readerThreads = 4;                    // threads issuing reads...
+    ReadBackend readBackend = ReadBackend::Auto; // ...with pread, or IoUring to batch them
+    size_t readDepth = 64;                       // files in flight per reader thread
+    size_t tokenizerThreads = std::thread::hardware_concurrency();
+    size_t pathQueueSize = 1024;                 // discovered paths waiting to be read
+    size_t textQueueSize = 64;                   // file contents waiting to be tokenized...
+    size_t textQueueBytes = 256 << 20;           // ...and their bytes at most (one larger file still passes)
+    size_t documentQueueSize = 256;              // counted documents waiting to be merged
+    ProcessingOptions processing;                // per-document options (minHash); files are never split
+};
+
+// Counters of one pipeline stage, summed over its threads
+struct CrawlStageStats {
+    const char* name = "";
+    size_t threads = 0;
+    uint64_t items = 0;        // directories for discovery, files for the other stages
+    uint64_t bytes = 0;        // file bytes that passed through
+    uint64_t busyNanos = 0;    // doing the stage's own work (for readers, including waits for I/O)
+    uint64_t starvedNanos = 0; // waiting on an empty input queue
+    uint64_t blockedNanos = 0; // waiting on a full output queue (backpressure)
+};
+
+struct CrawlStats {
+    enum Stage { Discover, Read, Tokenize, Merge };
+
+    std::array<CrawlStageStats, 4> stages;
+    std::array<QueueStats, 3> queues; // paths, texts, documents: between consecutive stages
+    uint64_t skipped = 0;             // directories and files that could not be read or processed
+    double seconds = 0;               // since run() started
+};
+
+// Recursive ingestion of directory trees as a pipeline of thread groups joined by
+// bounded queues:
+//
+//   discover --paths--> read --texts--> tokenize --documents--> merge
+//
+// Discovery lists directories concurrently, so listing a slow file system overlaps
+// with reading and counting the files already found. Readers only do I/O, each
+// keeping up to readDepth files in flight with a BatchReader; tokenizers
+// only CPU work, and a single merger adds the documents to the collection, so the
+// collection locks never see contention from ingestion. Full queues block the stage
+// before them. Files are read whole, so the text queue is limited by bytes as well
+// as by files: memory stays bounded by the queue limits plus the files in flight in
+// the readers, however far discovery runs ahead and however large the files are.
+//
+// An item whose processing throws (out of memory, a file system error) is reported
+// and counted as skipped; its stage carries on with the next one.
+//
+// Stages run on their own threads rather than a ThreadPool, since blocking reads and
+// blocking queue pushes would tie up pool workers. A pipeline runs one crawl.
+class CrawlPipeline {
+private:
+    struct FileText {
+        std::string path;
+        std::string text;
+    };
+
+    struct StageCounters {
+        std::atomic<uint64_t> items{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> busyNanos{0};
+
+        void add(uint64_t itemBytes, uint64_t nanos);
+    };
+
+    std::shared_ptr<DocumentCollection> collection;
+    CrawlOptions options;
+
+    BoundedQueue<std::string> paths;
+    BoundedQueue<FileText> texts;
+    BoundedQueue<DocumentStats> documents;
+    std::array<StageCounters, 4> counters;
+    std::atomic<uint64_t> skipped{0};
+    std::atomic<int64_t> startNanos{0};
+    std::atomic<int64_t> endNanos{0};
+    bool started = false;
+
+    // Directories still to be listed; discovery ends when none is queued or in progress
+    std::mutex directoryMtx;
+    std::condition_variable directoryAvailable;
+    std::vector<std::string> directories;
+    size_t activeDirectories = 0;
+
+    bool matches(const fs::path& path) const;
+    // Reports an item dropped by an exception and counts it as skipped
+    void skip(const std::string& item, const std::exception& error);
+    void discover();
+    void read();
+    void tokenize();
+    void merge();
+
+public:
+    CrawlPipeline(std::shared_ptr<DocumentCollection> coll, const CrawlOptions& opts = CrawlOptions());
+
+    CrawlPipeline(const CrawlPipeline&) = delete;
+    CrawlPipeline& operator=(const CrawlPipeline&) = delete;
+
+    // Crawls the roots (directories or single files) and blocks until every
+    // matching file is in the collection. Returns the number of documents added.
+    size_t run(const std::vector<std::string>& roots);
+
+    // Safe to call from another thread while run() is in progress
+    CrawlStats getStats() const;
+    // Per-stage throughput, busy/starved/blocked time and queue peaks
+    void printStats() const;
+};
+
+#endif // CRAWLER_H_
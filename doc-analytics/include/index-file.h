@@ -0,0 +1,110 @@
+#ifndef INDEX_FILE_H_
+#define INDEX_FILE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "tf-idf.h"
+
+// Binary TF-IDF index, written by TFIDFMatrix::saveIndex() and opened in place
+// by IndexFile. All sections are 8-byte aligned arrays in native byte order:
+//
+//   IndexHeader
+//   termOffsets   uint64[termCount + 1]   term id -> byte range in termChars
+//   termChars     char[]
+//   sortedTerms   uint32[termCount]       term ids in byte order of the term, for lookups
+//                                         (with hashBits set the three hold no terms:
+//                                         termOffsets is {0}, and lookups hash the word)
+//   docOffsets    uint64[docCount + 1]    document id -> byte range in docChars
+//   docChars      char[]
+//   docTotals     int64[docCount]         total terms; -1 marks a removed document
+//   docFrequency  int32[termCount]
+//   idf           double[termCount]
+//   postingOffsets uint64[termCount + 1]  CSR row offsets
+//   postingDocOffsets uint64[termCount + 1] word offsets of each term in postingDocs
+//                                         (the postingOffsets section itself when plain)
+//   postingDocs   uint32[]                document ids, ascending per term: one per
+//                                         posting, or compressed (postings-codec.h)
+//   termScales    double[termCount]       per-term decoding scale (1 unless quantized)
+//   postingValues Value[nonZeros]         TF values (score = value * scale * idf), where
+//                                         Value is the type of scoreStorage
+//
+// Version 2 added scoreStorage and termScales; version 3 docIdEncoding and postingDocOffsets;
+// version 4 hashBits.
+struct IndexHeader {
+    static constexpr char MAGIC[8] = { 'D', 'O', 'C', 'I', 'D', 'X', '\0', '\0' };
+    static constexpr uint32_t VERSION = 4;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t termCount;
+    uint64_t docCount;
+    uint64_t nonZeros;
+    uint64_t fileSize;
+    uint32_t scoreStorage;  // a ScoreStorage value
+    uint32_t docIdEncoding; // a DocIdEncoding value
+    uint32_t hashBits;      // of a hashed TermDictionary (termCount = 2^hashBits), else 0
+    uint32_t reserved;
+
+    // Byte offsets of the sections, from the start of the file
+    uint64_t termOffsets;
+    uint64_t termChars;
+    uint64_t sortedTerms;
+    uint64_t docOffsets;
+    uint64_t docChars;
+    uint64_t docTotals;
+    uint64_t docFrequency;
+    uint64_t idf;
+    uint64_t postingOffsets;
+    uint64_t postingDocOffsets;
+    uint64_t postingDocs;
+    uint64_t termScales;
+    uint64_t postingValues;
+};
+
+// Read-only view of an index file. Opening maps the file and checks the header,
+// the section bounds, every postings list's offsets (and skip table, when
+// compressed) and that every list holds ascending ids below the document count, so
+// later reads cannot leave the file or the per-document arrays; nothing is copied.
+class IndexFile : public PostingsSource {
+private:
+    MappedFile file;
+    const IndexHeader* header = nullptr;
+
+    template <typename T>
+    const T* section(uint64_t offset) const {
+        return reinterpret_cast<const T*>(file.data().data() + offset);
+    }
+
+    bool validate(const std::string& path);
+
+public:
+    explicit IndexFile(const std::string& path);
+
+    bool isOpen() const { return header != nullptr; }
+
+    size_t getTermCount() const override { return header->termCount; }
+    size_t getDocumentCount() const override { return header->docCount; }
+    size_t getNonZeros() const { return header->nonZeros; }
+
+    // Empty when the index was saved from a hashed dictionary
+    std::string_view getTerm(TermId term) const override;
+    unsigned getHashBits() const override { return header->hashBits; }
+    std::optional<TermId> findTerm(std::string_view term) const override;
+
+    std::string_view getDocumentName(DocId doc) const override;
+    int64_t getTotalTerms(DocId doc) const;
+    bool isRemoved(DocId doc) const { return getTotalTerms(doc) < 0; }
+
+    int getDocumentFrequency(TermId term) const;
+    double getIDF(TermId term) const override;
+    ScoreStorage getScoreStorage() const override { return static_cast<ScoreStorage>(header->scoreStorage); }
+    DocIdEncoding getDocIdEncoding() const { return static_cast<DocIdEncoding>(header->docIdEncoding); }
+    // TF values of every document containing the term
+    PostingsList getPostings(TermId term) const override;
+};
+
+#endif // INDEX_FILE_H_
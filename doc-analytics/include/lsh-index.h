@@ -0,0 +1,58 @@
+#ifndef LSH_INDEX_H_
+#define LSH_INDEX_H_
+
+#include <unordered_map>
+#include <vector>
+#include "minhash.h"
+#include "similarity.h"
+#include "tf-idf.h"
+
+// What getCandidatePairs() left out because of the bucket size limit
+struct LSHPairStats {
+    size_t oversizedBuckets = 0; // buckets over maxBucketSize, summed over bands
+    uint64_t droppedPairs = 0;   // colliding pairs not generated (before deduplication)
+};
+
+// Locality-sensitive hashing over MinHash signatures. A signature is cut into
+// `bandCount` bands of MINHASH_SIZE / bandCount lanes; two documents become a
+// candidate pair when any band matches exactly. With b bands of r lanes, a pair of
+// Jaccard similarity s is found with probability 1 - (1 - s^r)^b, a curve that is
+// steepest around getThreshold() = (1/b)^(1/r). Only documents sharing a bucket are
+// ever compared, so the cost follows the number of near-duplicates rather than n^2.
+// That stops holding when many documents share a band (boilerplate, empty-ish texts),
+// so a bucket yields pairs among at most maxBucketSize of its documents.
+class LSHIndex {
+private:
+    size_t bandCount;
+    size_t rowsPerBand;
+    size_t maxBucketSize;
+    std::vector<std::unordered_map<uint64_t, std::vector<DocId>>> buckets; // [band][band hash]
+    std::vector<MinHashSignature> signatures; // [document]
+    std::vector<bool> indexed;                // [document]
+
+    uint64_t hashBand(const MinHashSignature& signature, size_t band) const;
+
+public:
+    // bandCount must divide MINHASH_SIZE; 32 bands of 4 lanes put the threshold near 0.42.
+    // A bucket with more than maxBucketSize documents (0 for no limit) is sampled down
+    // to that many, spread evenly over the order they were added in.
+    explicit LSHIndex(size_t bandCount = 32, size_t maxBucketSize = 1024);
+
+    void add(DocId doc, const MinHashSignature& signature);
+    // Adds every live document of the collection that has a signature
+    // (see ProcessingOptions::minHash)
+    void addCollection(const DocumentCollection& collection);
+
+    // Documents sharing at least one band with the signature, ascending
+    std::vector<DocId> getCandidates(const MinHashSignature& signature) const;
+    // Every candidate pair whose estimated Jaccard similarity is at least
+    // minSimilarity, ordered by (first, second). Bands are scanned on the pool.
+    // Pairs dropped by the bucket size limit are counted in `stats` when given.
+    std::vector<SimilarPair> getCandidatePairs(double minSimilarity = 0.0, ThreadPool* pool = nullptr,
+                                               LSHPairStats* stats = nullptr) const;
+
+    double getThreshold() const;
+    size_t size() const;
+};
+
+#endif // LSH_INDEX_H_
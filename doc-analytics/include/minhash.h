@@ -0,0 +1,43 @@
+#ifndef MINHASH_H_
+#define MINHASH_H_
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Number of hash functions, i.e. 32-bit lanes, in a signature
+constexpr size_t MINHASH_SIZE = 128;
+
+// MinHash sketch of a document's term set: lane i holds the smallest value of hash
+// function i over the terms. The fraction of equal lanes between two signatures
+// estimates the Jaccard similarity of the two sets (standard error ~ 1 / sqrt(128)).
+// Fixed size and 32-byte aligned, so comparisons compile to plain vector compares.
+struct alignas(32) MinHashSignature {
+    std::array<uint32_t, MINHASH_SIZE> values;
+
+    MinHashSignature() { values.fill(UINT32_MAX); }
+
+    // True until a term has been added
+    bool empty() const;
+};
+
+// Accumulates the signature of one term set. Terms are hashed by their bytes, not
+// by TermId, so signatures do not depend on the dictionary they were counted with;
+// the exception is a hashed dictionary, whose bucket ids go through addHashed().
+// Signatures then depend on its hashBits and are not comparable with signatures
+// counted under a different setting (or with text terms).
+class MinHasher {
+private:
+    MinHashSignature signature;
+
+public:
+    void add(std::string_view term);
+    // For terms that are already hashed, such as the ids of a hashed dictionary
+    void addHashed(uint64_t termHash);
+    const MinHashSignature& getSignature() const { return signature; }
+};
+
+// Estimated Jaccard similarity of the sets behind two signatures (0 if either is empty)
+double estimateJaccard(const MinHashSignature& a, const MinHashSignature& b);
+
+#endif // MINHASH_H_
@@ -0,0 +1,105 @@
+#ifndef POSTINGS_CODEC_H_
+#define POSTINGS_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How the document ids of a postings list are stored
+enum class DocIdEncoding : uint32_t {
+    Plain = 0,  // uint32 per posting
+    Packed = 1  // delta + bit-packed blocks, see below
+};
+
+// Compressed document ids. A list of n ascending ids is cut into n / 128 full blocks
+// and a tail of n % 128 ids. Every id is stored as its gap to the previous one minus
+// one (the first gap is taken from -1), so blocks decode independently given the
+// last id of the block before. Layout of a list, in uint32 words:
+//
+//   skip    {lastDoc, wordOffset}[fullBlocks + 1]  last id and data offset of every
+//                                                  block; the final entry is the tail
+//   blocks  {bits, packed[4 * bits]}               128 gaps of `bits` bits each, split
+//                                                  over 4 interleaved lanes (gap i in
+//                                                  lane i % 4), so unpacking works on
+//                                                  4 gaps per vector operation
+//   tail    LEB128 varint gaps, zero padded to a whole word
+constexpr size_t DOC_BLOCK_SIZE = 128;
+
+inline size_t getDocBlockCount(size_t count) {
+    return (count + DOC_BLOCK_SIZE - 1) / DOC_BLOCK_SIZE;
+}
+
+// Appends the compressed form of `count` ascending ids to `out`
+void encodeDocIds(const uint32_t* docs, size_t count, std::vector<uint32_t>& out);
+
+// Whether a compressed list of `count` ids can be decoded within its `words` words
+// and decodes to valid ids: the skip table and every block offset fall inside the
+// list, block widths are at most 32 bits, the tail's varints end inside it, the ids
+// rise strictly and stay below `docCount`, and the skip table holds each block's
+// last id. For lists read from files.
+bool checkDocIds(const uint32_t* list, size_t words, size_t count, size_t docCount);
+
+// Decodes one block of a compressed list of `count` ids into `out` (room for
+// DOC_BLOCK_SIZE) and returns the number of ids in it; the list has to be well formed
+// (see checkDocIds)
+size_t decodeDocBlock(const uint32_t* list, size_t count, size_t block, uint32_t* out);
+
+// Largest id of one block, read from the skip table
+inline uint32_t getDocBlockLast(const uint32_t* list, size_t count, size_t block) {
+    size_t fullBlocks = count / DOC_BLOCK_SIZE;
+    return list[2 * (block < fullBlocks ? block : fullBlocks)];
+}
+
+// Calls fn(ids, first, n) for consecutive runs of a list, `first` being the
+// position of ids[0] in the list. Plain lists are passed through in one run;
+// compressed ones are decoded a block at a time.
+template <typename Fn>
+void forEachDocBlock(const uint32_t* plain, const uint32_t* packed, size_t count, Fn&& fn) {
+    if (!packed) {
+        fn(plain, size_t(0), count);
+        return;
+    }
+    alignas(16) uint32_t buffer[DOC_BLOCK_SIZE];
+    for (size_t block = 0; block < getDocBlockCount(count); ++block) {
+        size_t n = decodeDocBlock(packed, count, block, buffer);
+        fn(static_cast<const uint32_t*>(buffer), block * DOC_BLOCK_SIZE, n);
+    }
+}
+
+// Forward iteration with skipping over a plain or compressed id list. Seeking
+// moves over the skip table first and decodes only the block that can hold the
+// target.
+class DocIdCursor {
+private:
+    const uint32_t* plain = nullptr;
+    const uint32_t* packed = nullptr;
+    size_t count = 0;
+    size_t blockCount = 0;
+    size_t block = 0;
+    size_t blockSize = 0; // ids in the current block
+    size_t pos = 0;       // within the current block
+    alignas(16) uint32_t buffer[DOC_BLOCK_SIZE];
+
+    const uint32_t* ids() const { return packed ? buffer : plain + block * DOC_BLOCK_SIZE; }
+    uint32_t blockLast(size_t b) const;
+    void load(size_t b);
+
+public:
+    DocIdCursor() = default;
+    DocIdCursor(const uint32_t* plainDocs, const uint32_t* packedDocs, size_t size);
+
+    bool done() const { return pos >= blockSize; }
+    uint32_t doc() const { return ids()[pos]; }
+    // Position of the current id in the whole list
+    size_t index() const { return block * DOC_BLOCK_SIZE + pos; }
+
+    void next() {
+        if (++pos == blockSize && block + 1 < blockCount) {
+            load(block + 1);
+        }
+    }
+    // Moves to the first id >= target
+    void seek(uint32_t target);
+};
+
+#endif // POSTINGS_CODEC_H_
@@ -0,0 +1,113 @@
+#ifndef POSTINGS_SOURCE_H_
+#define POSTINGS_SOURCE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include "postings-codec.h"
+#include "sparse-matrix.h"
+#include "term-dictionary.h"
+
+// Position of a document inside its DocumentCollection
+using DocId = uint32_t;
+
+// How postings values are stored. The quantized forms keep an unsigned integer per
+// posting and one scale per term, the integer times the scale being the value.
+enum class ScoreStorage : uint32_t {
+    Double = 0,
+    Float32 = 1,
+    Quantized16 = 2,
+    Quantized8 = 3
+};
+
+// Calls fn(Value()) with the C++ type behind `storage`, so a loop over values is
+// compiled once per encoding instead of branching on it per posting
+template <typename Fn>
+decltype(auto) dispatchScoreStorage(ScoreStorage storage, Fn&& fn) {
+    switch (storage) {
+    case ScoreStorage::Float32:
+        return fn(float());
+    case ScoreStorage::Quantized16:
+        return fn(uint16_t());
+    case ScoreStorage::Quantized8:
+        return fn(uint8_t());
+    default:
+        return fn(double());
+    }
+}
+
+// Bytes per stored value
+inline size_t getScoreSize(ScoreStorage storage) {
+    return dispatchScoreStorage(storage, [](auto tag) { return sizeof(tag); });
+}
+
+inline const char* getScoreStorageName(ScoreStorage storage) {
+    switch (storage) {
+    case ScoreStorage::Float32:
+        return "float32";
+    case ScoreStorage::Quantized16:
+        return "quantized16";
+    case ScoreStorage::Quantized8:
+        return "quantized8";
+    default:
+        return "double";
+    }
+}
+
+// One term's postings in their stored encoding: posting i is the i-th document id with
+// value valuesAs<Value>()[i] * scale, where Value is the type of the source's ScoreStorage.
+// The ids are either a plain array (docs) or a compressed list (packedDocs, see
+// postings-codec.h); read them through DocIdCursor or forEachPosting().
+struct PostingsList {
+    const uint32_t* docs = nullptr;
+    const void* values = nullptr;
+    size_t size = 0;
+    double scale = 1.0;
+    const uint32_t* packedDocs = nullptr;
+
+    bool empty() const { return size == 0; }
+    DocIdCursor docIds() const { return DocIdCursor(docs, packedDocs, size); }
+
+    template <typename Value>
+    const Value* valuesAs() const { return static_cast<const Value*>(values); }
+};
+
+// Term-major postings as seen by the query side. Implemented both by an
+// in-memory TFIDFMatrix and by a mapped IndexFile, so the same engines run on either.
+class PostingsSource {
+public:
+    virtual ~PostingsSource() = default;
+
+    virtual size_t getTermCount() const = 0;
+    // Upper bound of the DocIds appearing in postings
+    virtual size_t getDocumentCount() const = 0;
+    virtual std::optional<TermId> findTerm(std::string_view term) const = 0;
+    // Text of a term; empty when the vocabulary is hashed
+    virtual std::string_view getTerm(TermId term) const = 0;
+    // Width of a hashed vocabulary (see TermDictionary), 0 when terms keep their text
+    virtual unsigned getHashBits() const { return 0; }
+    virtual std::string_view getDocumentName(DocId doc) const = 0;
+
+    virtual double getIDF(TermId term) const = 0;
+    virtual ScoreStorage getScoreStorage() const { return ScoreStorage::Double; }
+    // TF values of every document containing the term, DocIds ascending
+    virtual PostingsList getPostings(TermId term) const = 0;
+};
+
+// Calls fn(doc, TF value) for every posting of the term, decoded
+template <typename Fn>
+void forEachPosting(const PostingsSource& source, TermId term, Fn&& fn) {
+    PostingsList postings = source.getPostings(term);
+    dispatchScoreStorage(source.getScoreStorage(), [&](auto tag) {
+        using Value = decltype(tag);
+        const Value* values = postings.valuesAs<Value>();
+        forEachDocBlock(postings.docs, postings.packedDocs, postings.size,
+            [&](const uint32_t* docs, size_t first, size_t count) {
+                for (size_t i = 0; i < count; ++i) {
+                    fn(static_cast<DocId>(docs[i]), values[first + i] * postings.scale);
+                }
+            });
+    });
+}
+
+#endif // POSTINGS_SOURCE_H_
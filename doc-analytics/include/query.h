@@ -0,0 +1,42 @@
+#ifndef QUERY_H_
+#define QUERY_H_
+
+#include <map>
+#include <string_view>
+#include <vector>
+#include "postings-source.h"
+
+// One ranked hit of a query
+struct SearchResult {
+    DocId doc;
+    double score; // cosine similarity between the query and the document
+};
+
+// Ranked retrieval over the postings of a TFIDFMatrix or IndexFile.
+// Scores are TF-IDF cosine similarities. Top-k is found document-at-a-time with
+// MaxScore: once the heap holds k documents, lists whose combined upper bounds
+// cannot lift a document past the current k-th score only get probed for
+// candidates found elsewhere, and a candidate is dropped as soon as its
+// remaining upper bound cannot reach the threshold.
+//
+// Construction makes one pass over all postings (document norms and per-term
+// upper bounds); rebuild the engine after the source changes.
+class QueryEngine {
+private:
+    const PostingsSource& source;
+    std::vector<double> inverseNorm; // [document] = 1 / |TF-IDF vector|, 0 for empty documents
+    std::vector<double> maxWeight;   // [term] = max over its postings of TF * IDF * inverseNorm
+
+    // MaxScore over the postings, with Value the source's stored score type
+    template <typename Value>
+    std::vector<SearchResult> rank(const std::map<TermId, int>& queryTerms, size_t k) const;
+
+public:
+    explicit QueryEngine(const PostingsSource& src);
+
+    // Tokenizes the query the same way documents are tokenized and returns the
+    // k best documents, best first (ties broken by lower DocId)
+    std::vector<SearchResult> search(std::string_view query, size_t k = 10) const;
+};
+
+#endif // QUERY_H_
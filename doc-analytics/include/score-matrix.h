@@ -0,0 +1,97 @@
+#ifndef SCORE_MATRIX_H_
+#define SCORE_MATRIX_H_
+
+#include <cstdint>
+#include <vector>
+#include "postings-source.h"
+
+// Encodes `count` TF values into `out` (count * getScoreSize(storage) bytes) and
+// returns the scale that decodes them. Quantized values are rounded against the
+// largest value of the list; a non-zero value never rounds down to zero, so every
+// posting keeps contributing to its document.
+double encodeScores(const double* values, size_t count, ScoreStorage storage, void* out);
+
+// Sparse rows of (index, value) pairs like SparseMatrix, with the values kept in a
+// ScoreStorage: doubles, float32, or 16/8-bit integers times a per-row scale.
+// Every row owns a slice of the shared arrays and fills it from the front, so the
+// rows can be laid out first and then filled in any order. A row that outgrows its
+// slice moves to the end of the arrays with twice the room; the space rows leave
+// behind stays unused until compact().
+class ScoreMatrix {
+private:
+    // Row r holds `size` entries at [begin, begin + size) and has room for `capacity`
+    struct Extent {
+        uint64_t begin;
+        uint32_t size;
+        uint32_t capacity;
+    };
+
+    ScoreStorage storage;
+    size_t valueSize;
+    std::vector<Extent> extents;       // [row]
+    std::vector<double> scales;        // [row]
+    std::vector<uint32_t> indices;
+    std::vector<unsigned char> values; // valueSize bytes per entry
+    uint64_t nonZeroCount = 0;
+
+    // Moves row r to the end of the arrays with room for `capacity` entries
+    void relocate(size_t r, uint32_t capacity);
+
+public:
+    // Read-only view over the entries of one row, indices ascending; value i is
+    // static_cast<const Value*>(values)[i] * scale with Value the storage's type
+    struct Row {
+        const uint32_t* indices;
+        const void* values;
+        size_t size;
+        double scale;
+
+        bool empty() const { return size == 0; }
+    };
+
+    explicit ScoreMatrix(ScoreStorage scoreStorage = ScoreStorage::Double);
+
+    ScoreStorage getStorage() const { return storage; }
+    size_t rowCount() const { return extents.size(); }
+    size_t nonZeros() const { return nonZeroCount; }
+    // Slots not holding an entry: room left in rows plus space abandoned by moved rows
+    size_t getUnusedSlots() const { return indices.size() - nonZeroCount; }
+    // Bytes held by the entries and the per-row bookkeeping
+    size_t getBytes() const;
+
+    Row row(size_t r) const;
+    // Empties the matrix and gives row r room for capacities[r] entries
+    void layout(const std::vector<uint32_t>& capacities);
+    // Adds empty rows until there are `count`
+    void growRows(size_t count);
+    // Makes quantized row r able to hold values up to `largest`: an empty row takes
+    // that scale, a filled one is re-encoded only when its scale has to grow.
+    // append() clamps larger values, so call this first.
+    void fitScale(size_t r, double largest);
+    // Adds an entry after the last one of row r, moving the row if it is full
+    void append(size_t r, uint32_t index, double value);
+    // Replaces the entries of row r and scales it to them
+    void setRow(size_t r, const uint32_t* rowIndices, const double* rowValues, size_t count);
+    // Drops the entries of row r whose index is flagged; the row keeps its room
+    void removeEntries(size_t r, const std::vector<char>& flagged);
+    void clearRow(size_t r);
+    // Packs the rows back to back without spare room, freeing the unused slots
+    void compact();
+    // Values of row r, decoded
+    void decodeRow(size_t r, std::vector<double>& out) const;
+
+    // Calls fn(index, value) for every entry of row r, decoded
+    template <typename Fn>
+    void forEach(size_t r, Fn&& fn) const {
+        Row entries = row(r);
+        dispatchScoreStorage(storage, [&](auto tag) {
+            using Value = decltype(tag);
+            const Value* rowValues = static_cast<const Value*>(entries.values);
+            for (size_t i = 0; i < entries.size; ++i) {
+                fn(entries.indices[i], rowValues[i] * entries.scale);
+            }
+        });
+    }
+};
+
+#endif // SCORE_MATRIX_H_
@@ -0,0 +1,61 @@
+#ifndef SIMILARITY_H_
+#define SIMILARITY_H_
+
+#include <vector>
+#include "postings-source.h"
+#include "query.h"
+#include "thread-pool.h"
+
+// Two documents whose similarity reached the requested threshold
+struct SimilarPair {
+    DocId first;  // always the lower DocId
+    DocId second;
+    double score;
+};
+
+// Document-to-document cosine similarity over TF-IDF vectors.
+// Construction copies the postings once as L2-normalized weights, in both term-major
+// and document-major order, so every similarity is a plain sparse dot product.
+// Terms with zero IDF (present in every document) carry no weight and are dropped.
+// Rebuild the engine after the source changes.
+class SimilarityEngine {
+private:
+    static constexpr size_t BLOCK_SIZE = 256; // documents per all-pairs task
+
+    SparseMatrix<double> termWeights; // row = term, column = document
+    SparseMatrix<double> docWeights;  // row = document, column = term
+    std::vector<double> maxWeight;    // [term] = largest normalized weight in its postings
+
+    // Per-worker buffers of findSimilarPairs(), allocated once for all its rows. The
+    // dense arrays are left zeroed between rows by resetting only the entries touched.
+    struct Scratch {
+        std::vector<double> accumulator; // [document] = partial dot product with the current row
+        std::vector<double> rowWeights;  // [term] = weight of the unscanned part of the current row
+        std::vector<DocId> candidates;
+        std::vector<std::pair<double, TermId>> terms; // the current row, heaviest first
+        std::vector<double> remainingBound;
+    };
+
+    // Appends every pair (doc, other > doc) scoring at least `threshold`
+    void collectPairs(DocId doc, double threshold, Scratch& scratch, std::vector<SimilarPair>& out) const;
+
+public:
+    explicit SimilarityEngine(const PostingsSource& source);
+
+    size_t getDocumentCount() const { return docWeights.rowCount(); }
+
+    // Cosine similarity of two documents (0 when either is empty or removed)
+    double similarity(DocId a, DocId b) const;
+    // The k documents most similar to `doc`, best first (ties broken by lower DocId)
+    std::vector<SearchResult> getNeighbours(DocId doc, size_t k = 10) const;
+    // Every pair scoring at least `threshold` (> 0), ordered by (first, second).
+    // Row-by-row sparse product of the matrix with its transpose, restricted to the
+    // upper triangle. Rows are processed in blocks, spread over one task per pool
+    // worker. Within a row, postings
+    // are scanned heaviest term first only while the weight left in the row could still
+    // lift an unseen document to the threshold; the candidates found by then are
+    // finished off against their own rows, skipping those that cannot make it.
+    std::vector<SimilarPair> findSimilarPairs(double threshold, ThreadPool* pool = nullptr) const;
+};
+
+#endif // SIMILARITY_H_
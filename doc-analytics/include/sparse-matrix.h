@@ -0,0 +1,67 @@
+#ifndef SPARSE_MATRIX_H_
+#define SPARSE_MATRIX_H_
+
+#include <cstdint>
+#include <vector>
+
+// Compressed sparse row storage: row r owns entries [offsets[r], offsets[r + 1])
+// of the contiguous `indices` / `values` arrays, with indices sorted ascending.
+// The same layout read with rows and columns swapped is the CSC form, which is
+// what transpose() builds.
+template <typename Value>
+struct SparseMatrix {
+    // Read-only view over the non-zeros of one row
+    struct Row {
+        const uint32_t* indices;
+        const Value* values;
+        size_t size;
+
+        bool empty() const { return size == 0; }
+    };
+
+    std::vector<uint64_t> offsets{0}; // rowCount() + 1 entries
+    std::vector<uint32_t> indices;
+    std::vector<Value> values;
+
+    size_t rowCount() const { return offsets.size() - 1; }
+    size_t nonZeros() const { return indices.size(); }
+
+    Row row(size_t r) const {
+        uint64_t begin = offsets[r];
+        return { indices.data() + begin, values.data() + begin,
+                 static_cast<size_t>(offsets[r + 1] - begin) };
+    }
+
+    void clear() {
+        offsets.assign(1, 0);
+        indices.clear();
+        values.clear();
+    }
+
+    // Counting-sort transpose; columns of the result stay sorted because rows are visited in order
+    SparseMatrix transpose(size_t columnCount) const {
+        SparseMatrix result;
+        result.offsets.assign(columnCount + 1, 0);
+        result.indices.resize(nonZeros());
+        result.values.resize(nonZeros());
+
+        for (uint32_t column : indices) {
+            result.offsets[column + 1]++;
+        }
+        for (size_t c = 0; c < columnCount; ++c) {
+            result.offsets[c + 1] += result.offsets[c];
+        }
+
+        std::vector<uint64_t> cursor(result.offsets.begin(), result.offsets.end() - 1);
+        for (size_t r = 0; r < rowCount(); ++r) {
+            for (uint64_t i = offsets[r]; i < offsets[r + 1]; ++i) {
+                uint64_t pos = cursor[indices[i]]++;
+                result.indices[pos] = static_cast<uint32_t>(r);
+                result.values[pos] = values[i];
+            }
+        }
+        return result;
+    }
+};
+
+#endif // SPARSE_MATRIX_H_
@@ -0,0 +1,104 @@
+#ifndef TERM_DICTIONARY_H_
+#define TERM_DICTIONARY_H_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Dense integer identifier of an interned term
+using TermId = uint32_t;
+
+// Thread-safe term interner shared by the whole pipeline.
+// Every distinct term is stored exactly once and gets a dense id (0, 1, 2, ...),
+// so the rest of the library can work on ids and only turn them back into
+// strings for output.
+//
+// A dictionary built with hashBits > 0 stores no terms at all (the hashing
+// trick): a term's id is its hash bucket out of 2^hashBits, so memory is fixed
+// whatever the corpus, distinct terms may share an id, and output can only name
+// the bucket ("#1234", see getTermName()). Phrases hash word by word, so the id of an n-gram
+// follows from the hashes of its words without building its text.
+class TermDictionary {
+private:
+    static constexpr size_t SHARD_COUNT = 64;
+    static constexpr unsigned MAX_HASH_BITS = 30;
+
+    // Lookups are spread across shards so concurrent processors rarely meet on the same lock
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<std::string_view, TermId> ids; // keys view into `terms`
+    };
+
+    std::array<Shard, SHARD_COUNT> shards;
+
+    mutable std::shared_mutex termsMtx;
+    std::deque<std::string> terms; // [id] = term, deque keeps references stable on growth
+
+    unsigned hashBits = 0;
+
+    Shard& shardFor(std::string_view term);
+
+public:
+    // hashBits == 0 interns terms; 1..30 hashes them into 2^hashBits buckets
+    explicit TermDictionary(unsigned hashBits = 0);
+    TermDictionary(const TermDictionary&) = delete;
+    TermDictionary& operator=(const TermDictionary&) = delete;
+
+    // Returns the id of `term`, assigning the next free id on first sight
+    TermId intern(std::string_view term);
+    std::optional<TermId> find(std::string_view term);
+
+    // The interned text; empty with hashing, where no text is kept
+    const std::string& getTerm(TermId id) const;
+    // For output: the interned text, or with hashing the bucket as "#id", formatted
+    // into `buffer` (which the result may point into)
+    std::string_view getTermName(TermId id, std::string& buffer) const;
+    // Ids in use; with hashing, the bucket count
+    size_t size() const;
+
+    bool isHashed() const { return hashBits != 0; }
+    unsigned getHashBits() const { return hashBits; }
+
+    // Stable 64-bit hash of one word, read 8 bytes at a time
+    static uint64_t hashWord(std::string_view word) {
+        uint64_t hash = 0x9E3779B97F4A7C15ull ^ word.size();
+        const char* p = word.data();
+        size_t n = word.size();
+        for (; n >= 8; p += 8, n -= 8) {
+            uint64_t chunk;
+            std::memcpy(&chunk, p, 8);
+            hash = (hash ^ chunk) * 0xBF58476D1CE4E5B9ull;
+            hash ^= hash >> 31;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, p, n);
+        hash = (hash ^ tail) * 0x94D049BB133111EBull;
+        return hash ^ (hash >> 29);
+    }
+
+    // Hash of `sequence` followed by one more word; order matters
+    static uint64_t extendHash(uint64_t sequence, uint64_t word) {
+        return ((sequence << 23 | sequence >> 41) ^ word) * 0x9E3779B97F4A7C15ull;
+    }
+
+    // Id of a hashed term (hashWord, or extendHash for phrases) out of 2^bits
+    static TermId getBucket(uint64_t hash, unsigned bits) {
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDull;
+        return static_cast<TermId>(hash >> (64 - bits));
+    }
+    TermId getBucket(uint64_t hash) const { return getBucket(hash, hashBits); }
+
+    // Bucket of a word or space-separated phrase, hashed word by word; also how an
+    // index saved from a hashed dictionary looks terms up
+    static TermId hashTerm(std::string_view term, unsigned bits);
+};
+
+#endif // TERM_DICTIONARY_H_
@@ -15,62 +15,380 @@
 #include <iomanip>
 #include <cmath>
 #include <filesystem>
+#include <charconv>
+#include <unordered_map>
+#include <array>
+#include <atomic>
+#include "term-dictionary.h"
+#include "sparse-matrix.h"
+#include "score-matrix.h"
+#include "postings-source.h"
+#include "thread-pool.h"
+#include "contention-counter.h"
+#include "tokenizer.h"
+#include "minhash.h"
+#include "weighting.h"
 
 namespace fs = std::filesystem;
 
-// Represents a single document's term frequencies
+// How often one term occurs in a document
+struct TermCount {
+    TermId term;
+    int count;
+};
+
+// A document's term counts, sorted by term: one allocation per document
+using TermCounts = std::vector<TermCount>;
+
+// A document as produced by DocumentProcessor, before it joins a collection
 struct DocumentStats {
     std::string docName;
-    std::map<std::string, int> termFrequency;
-    int totalTerms = 0;
+    TermCounts termFrequency;
+    int64_t totalTerms = 0;
+    MinHashSignature signature; // of the term set; empty unless ProcessingOptions::minHash was set
 };
 
-// Thread-safe document collection manager
+// Contiguous run of a document's counts inside a DocumentCollection
+struct TermCountRange {
+    const TermCount* first = nullptr;
+    const TermCount* last = nullptr;
+
+    const TermCount* begin() const { return first; }
+    const TermCount* end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+};
+
+// Read-only view of one document of a DocumentCollection. A removed or unknown
+// DocId gives a view that tests false. Views point into the collection's arrays
+// and are invalidated by the next addDocument().
+struct DocumentView {
+    std::string_view docName;
+    int64_t totalTerms = 0;
+    TermCountRange termFrequency;
+    const MinHashSignature* signature = nullptr; // nullptr unless the document was sketched
+    bool live = false;
+
+    explicit operator bool() const { return live; }
+};
+
+// Thread-safe document collection manager.
+// Documents are stored flat: one array of fixed-size headers, one array with the
+// (term, count) pairs of every document back to back, and one with their names, so
+// a document costs its header (24 bytes) plus its name and counts, and full-corpus
+// scans walk memory in order. Adding a document is an append to those arrays under
+// the document lock; document frequencies are striped by term id so concurrent
+// processors mostly update disjoint stripes.
 class DocumentCollection {
 private:
+    static constexpr size_t STRIPE_COUNT = 64;
+    static constexpr int64_t REMOVED = -1; // totalTerms of an emptied slot
+
+    // Document frequencies of the terms with term % STRIPE_COUNT == stripe index;
+    // readers lock too, since adding a term resizes counts
+    struct FrequencyStripe {
+        mutable std::mutex mtx;
+        std::vector<int> counts; // [term / STRIPE_COUNT] = number of documents containing it
+    };
+
+    // A document's counts and name end where the next header's begin
+    struct DocumentHeader {
+        uint64_t termOffset; // into counts
+        uint64_t nameOffset; // into names
+        int64_t totalTerms;
+    };
+
     std::mutex mtx;
-    std::vector<std::shared_ptr<DocumentStats>> documents;
-    std::set<std::string> vocabulary;
+    std::shared_ptr<TermDictionary> dictionary;
+    std::vector<DocumentHeader> headers;         // [DocId], plus one closing the last document
+    std::vector<TermCount> counts;
+    std::vector<char> names;
+    std::vector<MinHashSignature> signatures;    // [DocId], from the first sketched document on
+    std::array<FrequencyStripe, STRIPE_COUNT> frequencyStripes;
+    std::atomic<size_t> vocabularySize{0}; // number of terms with a non-zero document frequency
+    std::atomic<size_t> liveDocuments{0};
+    ContentionCounter contention;
+    
+    void adjustFrequencies(TermCountRange terms, int delta);
     
 public:
-    void addDocument(std::shared_ptr<DocumentStats> doc);
+    DocumentCollection(std::shared_ptr<TermDictionary> dict = std::make_shared<TermDictionary>());
+
+    // Copies the document in and returns its DocId
+    DocId addDocument(const DocumentStats& doc);
+    // Removed documents keep their slot (an empty view) so DocIds stay stable;
+    // their counts stay in the arrays
+    bool removeDocument(DocId id);
+    bool removeDocument(const std::string& docName);
     size_t getDocumentCount() const;
-    const std::set<std::string>& getVocabulary() const;
-    const std::vector<std::shared_ptr<DocumentStats>>& getDocuments() const;
-    int getDocumentFrequency(const std::string& term) const;
+    // DocIds handed out so far, removed documents included
+    size_t getSlotCount() const;
+    DocumentView getDocument(DocId id) const;
+    std::vector<TermId> getVocabulary() const;
+    size_t getVocabularySize() const;
+    int getDocumentFrequency(TermId term) const;
+    // Bytes held by documents in the arrays; spare capacity from growth is not counted
+    size_t getStorageBytes() const;
+
+    TermDictionary& getDictionary() const;
+    // Lock wait statistics of addDocument() across the document and frequency locks
+    ContentionCounter::Snapshot getContentionStats() const;
+};
+
+// How DocumentProcessor reads its file
+struct ProcessingOptions {
+    bool streaming = false;                 // read fixed-size chunks instead of mapping the file
+    size_t chunkSize = 1 << 20;             // bytes per read in streaming mode
+    uint64_t parallelThreshold = 64 << 20;  // files this large are split into ranges...
+    uint64_t rangeSize = 16 << 20;          // ...of roughly this many bytes
+    ThreadPool* pool = nullptr;             // runs the ranges; without a pool files are counted whole
+    bool minHash = false;                   // also fill DocumentStats::signature (for LSHIndex)
+    size_t minNgram = 1;                    // counted phrases are runs of minNgram..maxNgram
+    size_t maxNgram = 1;                    // consecutive words, "new york" for bigrams
 };
 
+// Longest phrase ProcessingOptions::maxNgram can ask for
+inline constexpr size_t MAX_NGRAM = 3;
+
 // Processes a single document
 class DocumentProcessor {
 private:
+    // Term counts of one whitespace-aligned byte range of the file. Phrases are
+    // built from the last words seen, so a phrase across two ranges is not counted.
+    struct RangeCounts {
+        TermCounter counts;  // by text, for a dictionary that interns terms
+        IdCounter buckets;   // by id, for a hashed dictionary
+        int64_t totalTerms = 0;
+        // [n] = the last n words, joined by spaces or hashed
+        std::array<std::string, MAX_NGRAM + 1> recentText;
+        std::array<uint64_t, MAX_NGRAM + 1> recentHash{};
+        size_t recent = 0;   // words seen so far, capped at MAX_NGRAM - 1
+
+        explicit RangeCounts(std::string_view stableText) : counts(stableText) {}
+
+        void reset(std::string_view stableText) {
+            counts.reset(stableText);
+            buckets.reset();
+            totalTerms = 0;
+            recent = 0;
+        }
+    };
+
     std::string filepath;
     std::shared_ptr<DocumentCollection> collection;
+    ProcessingOptions options;
     
-    std::string cleanWord(const std::string& word);
+    std::vector<uint64_t> splitRanges(std::string_view text, uint64_t size);
+    void countText(Tokenizer& tokenizer, std::string_view text, RangeCounts& range);
+    // Counts the phrases ending at `word`, by text or by hash
+    void countPhrases(std::string_view word, RangeCounts& range);
+    void countHashed(std::string_view word, RangeCounts& range);
+    void countStreamed(uint64_t begin, uint64_t end, RangeCounts& range);
+    // The calling thread's counts, emptied for a new document; reused so that
+    // counting a document normally allocates nothing
+    static RangeCounts& getWorkspace(std::string_view stableText);
+    // Interns the counted terms and fills in the document's stats
+    DocumentStats buildStats(const RangeCounts& localCounts);
     
 public:
     DocumentProcessor(const std::string& path, 
-                     std::shared_ptr<DocumentCollection> coll);
+                     std::shared_ptr<DocumentCollection> coll,
+                     const ProcessingOptions& opts = ProcessingOptions());
     
+    // Reads, counts and adds the file to the collection
     void process();
+    // Counts text already read from the file; the result is not added to the collection
+    DocumentStats processText(std::string_view text);
+};
+
+// Runs DocumentProcessor jobs on a bounded work-stealing pool
+class IngestionEngine {
+private:
+    std::shared_ptr<DocumentCollection> collection;
+    ThreadPool pool;
+    ProcessingOptions options;
+
+public:
+    IngestionEngine(std::shared_ptr<DocumentCollection> coll,
+                    size_t threadCount = std::thread::hardware_concurrency(),
+                    const ProcessingOptions& opts = ProcessingOptions());
+
+    // Queues one file; returns immediately
+    void submit(const std::string& path);
+    // Queues every file and waits for all of them
+    void ingest(const std::vector<std::string>& paths);
+    void wait();
+    size_t getThreadCount() const;
+    // The ingestion workers, also usable for the parallel TF-IDF phases
+    ThreadPool& getPool();
+};
+
+// How TFIDFMatrix::exportToCSV() writes the matrix
+struct ExportOptions {
+    enum class Layout {
+        Dense,   // one row per term, one column per document, zeros included
+        Triplets // one "term,document,score" line per non-zero score
+    };
+    
+    Layout layout = Layout::Dense;
+    char delimiter = ',';           // '\t' for TSV
+    int precision = 6;              // significant digits; 0 writes the shortest exact form
+    size_t bufferSize = 4 << 20;    // file stream buffer
+    ThreadPool* pool = nullptr;     // formats row blocks in parallel; output order is unchanged
+};
+
+// Type-erased face of a WeightingScheme inside TFIDFMatrix. It is called once per
+// document or per IDF refresh; the loops over individual cells run inside
+// WeightingAdapter, compiled for the concrete scheme.
+class Weighting {
+public:
+    virtual ~Weighting() = default;
+
+    // Terms and TF values of doc.termFrequency, in term order (one pass over the counts)
+    virtual void scoreDocument(const DocumentView& doc, const CorpusShape& corpus,
+                               TermId* terms, double* values) const = 0;
+    // idf[term] for the flagged terms (every term without flags), 0 when no live document has it
+    virtual void scoreTerms(const DocumentCollection& collection, const std::vector<char>* changedTerms,
+                            std::vector<double>& idf) const = 0;
+    virtual bool usesAverageLength() const = 0;
+    virtual bool normalizes() const = 0;
+};
+
+template <typename Scheme>
+class WeightingAdapter : public Weighting {
+private:
+    Scheme scheme;
+
+public:
+    explicit WeightingAdapter(const Scheme& s) : scheme(s) {}
+
+    void scoreDocument(const DocumentView& doc, const CorpusShape& corpus,
+                       TermId* terms, double* values) const override {
+        DocumentShape shape;
+        shape.length = doc.totalTerms;
+        if constexpr (Scheme::TF::NEEDS_MAX_FREQUENCY) {
+            for (const auto& [term, freq] : doc.termFrequency) {
+                shape.maxFrequency = std::max(shape.maxFrequency, freq);
+            }
+        }
+        for (const auto& [term, freq] : doc.termFrequency) {
+            *terms++ = term;
+            *values++ = scheme.tf(freq, shape, corpus);
+        }
+    }
+
+    void scoreTerms(const DocumentCollection& collection, const std::vector<char>* changedTerms,
+                    std::vector<double>& idf) const override {
+        size_t totalDocs = collection.getDocumentCount();
+        for (TermId term = 0; term < idf.size(); ++term) {
+            if (changedTerms && !(*changedTerms)[term]) {
+                continue;
+            }
+            int docFreq = collection.getDocumentFrequency(term);
+            idf[term] = docFreq > 0 ? scheme.idf(docFreq, totalDocs) : 0.0;
+        }
+    }
+
+    bool usesAverageLength() const override { return Scheme::TF::NEEDS_AVERAGE_LENGTH; }
+    bool normalizes() const override { return Scheme::Norm::ENABLED; }
+};
+
+// A term and its TF-IDF score within one document
+struct TermScore {
+    TermId term;
+    double score;
+};
+
+// Scores of one term across the documents that contain it
+struct TermStatistics {
+    int docFrequency = 0;
+    double sum = 0;
+    double max = 0;
+    
+    double mean() const { return docFrequency > 0 ? sum / docFrequency : 0.0; }
 };
 
 // TF-IDF Matrix generator
-class TFIDFMatrix {
+class TFIDFMatrix : public PostingsSource {
 private:
     std::shared_ptr<DocumentCollection> collection;
-    std::map<std::string, std::map<std::string, double>> matrix; // [term][document] = score
+    ScoreMatrix termMajor;          // TF values (normalized when the scheme asks): row = term, column = document
+    ScoreMatrix docMajor;           // the same values by document: row = document, column = term
+    std::vector<double> idf;        // [term]; score = TF * idf[term]
+    std::vector<bool> indexedDocs;  // [document] = its terms are in the matrix
+    size_t indexedDocCount = 0;     // corpus size the IDF values were computed for
+    std::vector<TermStatistics> termStats; // [term], in stored units (before IDF)
+    
+    std::shared_ptr<const Weighting> weighting;
     
-    double calculateTF(int termFreq, int totalTerms);
-    double calculateIDF(int docFreq, int totalDocs);
+    // Live document count, plus the average length when the scheme needs it
+    CorpusShape getCorpusShape() const;
+    // Recomputes IDF for the flagged terms, or for every term when no flags are given
+    void refreshIDF(size_t termCount, const std::vector<char>* changedTerms);
+    // TF values of a document in term order, scaled so its score vector has unit
+    // length when the scheme normalizes (which needs the IDF values current)
+    void scoreRow(const DocumentView& doc, const CorpusShape& corpus,
+                  std::vector<TermId>& terms, std::vector<double>& values) const;
+    // One pass over the flagged term rows (all rows when no flags are given)
+    void refreshTermStatistics(const std::vector<char>* changedTerms, ThreadPool* pool);
+    // Splits [0, termCount) into at most `parts` ranges of similar posting volume
+    std::vector<TermId> splitTermRange(size_t termCount, size_t parts) const;
+    // Appends the export lines of terms[first, last) to `out`
+    void formatRows(const std::vector<TermId>& terms, size_t first, size_t last,
+                    const std::vector<DocId>& liveDocs, const ExportOptions& options,
+                    std::string& out) const;
     
 public:
-    TFIDFMatrix(std::shared_ptr<DocumentCollection> coll);
+    // Scores with the given WeightingScheme (see weighting.h); the default is
+    // count / length times log(N / df), without normalization. The TF values are
+    // held as `storage`: float32 halves the value memory, the quantized forms keep
+    // 16 or 8 bits per value with one scale per row.
+    template <typename Scheme = ClassicTFIDF>
+    TFIDFMatrix(std::shared_ptr<DocumentCollection> coll, const Scheme& scheme = Scheme(),
+                ScoreStorage storage = ScoreStorage::Double)
+        : collection(coll), termMajor(storage), docMajor(storage),
+          weighting(std::make_shared<WeightingAdapter<Scheme>>(scheme)) {}
     
-    void compute();
+    // Builds the matrix from scratch. With a pool, the documents are split into
+    // partitions that score into preallocated rows in parallel; the term rows are
+    // then filled in one pass over the documents in order.
+    void compute(ThreadPool* pool = nullptr);
+    // Brings the matrix in line with documents added to or removed from the collection
+    // since the last compute()/update(). Returns false when nothing changed.
+    // Only the rows of the changed documents and of their terms are patched; rows
+    // that outgrow their room move, and the matrix is repacked once the space left
+    // behind exceeds its entries. Schemes that normalize or use the average length
+    // rescore everything.
+    bool update();
+    // Bytes held by the score rows, IDF and term statistics
+    size_t getStorageBytes() const;
+    // The k highest scoring terms of a document, best first. Selects with
+    // nth_element over the document's own row, so cost follows its non-zeros.
+    std::vector<TermScore> getTopTerms(DocId doc, size_t k) const;
+    // getTopTerms() for every document slot (empty for removed documents)
+    std::vector<std::vector<TermScore>> getTopTermsPerDocument(size_t k, ThreadPool* pool = nullptr) const;
     void printTopTermsPerDocument(int topN = 10);
+    // Per-term aggregates, kept up to date by compute() and update()
+    TermStatistics getTermStatistics(TermId term) const;
+    // The k terms with the highest mean score over the documents containing them
+    std::vector<TermScore> getTopTermsByMeanScore(size_t k) const;
     void printMatrix(int maxTerms = 20);
-    void exportToCSV(const std::string& filename);
+    void exportToCSV(const std::string& filename, const ExportOptions& options = ExportOptions());
+    // Writes the binary index described in index-file.h, with the postings values
+    // stored as `storage` and the document ids as `docIdEncoding`; open it again with IndexFile
+    bool saveIndex(const std::string& filename, ScoreStorage storage = ScoreStorage::Double,
+                   DocIdEncoding docIdEncoding = DocIdEncoding::Plain);
+    
+    // PostingsSource
+    size_t getTermCount() const override;
+    size_t getDocumentCount() const override;
+    std::optional<TermId> findTerm(std::string_view term) const override;
+    std::string_view getTerm(TermId term) const override;
+    unsigned getHashBits() const override;
+    std::string_view getDocumentName(DocId doc) const override;
+    double getIDF(TermId term) const override;
+    ScoreStorage getScoreStorage() const override;
+    PostingsList getPostings(TermId term) const override;
 };
 
 #endif // TF_IDF_H_
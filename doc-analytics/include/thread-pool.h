@@ -0,0 +1,101 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing thread pool.
+// Every worker owns a deque: it pops its own work LIFO (cache-warm) while idle
+// workers steal FIFO from the others, so uneven jobs still keep all cores busy.
+class ThreadPool {
+private:
+    using Task = std::function<void()>;
+
+    struct WorkQueue {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex sleepMtx;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+
+    std::atomic<size_t> queued{0};   // tasks sitting in a queue, changed under its lock
+    std::atomic<size_t> pending{0};  // tasks submitted but not finished
+    std::atomic<size_t> nextQueue{0};
+    bool stopping = false;           // guarded by sleepMtx
+
+    bool popLocal(size_t index, Task& task);
+    bool steal(size_t index, Task& task);
+    void execute(Task& task);
+    void run(size_t index);
+
+    // Runs one queued task on the calling thread, if there is any
+    bool runPendingTask();
+
+    friend class TaskGroup;
+
+public:
+    explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Tasks submitted from a worker go to that worker's own queue
+    void submit(Task task);
+    // Blocks until every submitted task has finished; must not be called from a worker
+    void wait();
+    size_t size() const;
+};
+
+// Tracks a subset of a pool's tasks so the caller can wait for just those.
+// Waiting keeps running queued tasks, so a pool task can fan out into a group
+// and wait for it without starving the pool.
+class TaskGroup {
+private:
+    ThreadPool& pool;
+    std::atomic<size_t> remaining{0};
+    std::mutex mtx;
+    std::condition_variable done;
+
+    void finishOne();
+
+public:
+    explicit TaskGroup(ThreadPool& p) : pool(p) {}
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void submit(std::function<void()> task);
+    void wait();
+};
+
+// Runs fn(0) .. fn(count - 1) on the pool and waits for them all.
+// Without a pool (or with a single item) everything runs on the calling thread.
+template <typename Fn>
+void parallelFor(ThreadPool* pool, size_t count, Fn&& fn) {
+    if (!pool || count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+    TaskGroup group(*pool);
+    for (size_t i = 0; i < count; ++i) {
+        group.submit([&fn, i]() { fn(i); });
+    }
+    group.wait();
+}
+
+#endif // THREAD_POOL_H_
@@ -0,0 +1,305 @@
+#ifndef TOKENIZER_H_
+#define TOKENIZER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "arena.h"
+
+// Read-only view of a whole file. Uses mmap where available and falls back to
+// reading the file into memory elsewhere.
+class MappedFile {
+private:
+    const char* mapped = nullptr;
+    size_t length = 0;
+    std::string fallback;
+    bool opened = false;
+
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return opened; }
+    std::string_view data() const;
+};
+
+// Character classes used by the tokenizer. Matches std::isspace / std::isalnum /
+// std::tolower in the "C" locale without the per-call locale lookup.
+enum CharClass : uint8_t {
+    CHAR_CLEAN = 0, // lowercase letter or digit, kept as is
+    CHAR_UPPER = 1, // uppercase letter, kept lowercased
+    CHAR_OTHER = 2, // punctuation and non-ASCII bytes, dropped
+    CHAR_SPACE = 4  // word separator
+};
+
+struct CharTables {
+    std::array<uint8_t, 256> charClass{};
+    std::array<char, 256> fold{}; // lowercase alnum, or 0 for characters that are dropped
+
+    constexpr CharTables() {
+        for (int c = 0; c < 256; ++c) {
+            if (c == ' ' || (c >= '\t' && c <= '\r')) {
+                charClass[c] = CHAR_SPACE;
+            } else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+                charClass[c] = CHAR_CLEAN;
+                fold[c] = static_cast<char>(c);
+            } else if (c >= 'A' && c <= 'Z') {
+                charClass[c] = CHAR_UPPER;
+                fold[c] = static_cast<char>(c - 'A' + 'a');
+            } else {
+                charClass[c] = CHAR_OTHER;
+            }
+        }
+    }
+};
+
+inline constexpr CharTables charTables{};
+
+// One whitespace-delimited word found by a scan kernel.
+// `flags` is the OR of the CharClass values of its bytes.
+struct TokenSpan {
+    size_t begin;
+    size_t length;
+    uint8_t flags;
+};
+
+// Word boundary scanners. Auto picks the widest one the CPU supports at runtime.
+enum class ScanKernel { Auto, Scalar, SSE2, AVX2 };
+
+// Scans text from `pos`, writing at most `capacity` spans and advancing `pos`
+// past the last one. Returns 0 only once the end of the text has been reached.
+using ScanFunction = size_t (*)(std::string_view text, size_t& pos,
+                                TokenSpan* out, size_t capacity);
+
+ScanFunction resolveScanKernel(ScanKernel kernel);
+bool isScanKernelSupported(ScanKernel kernel);
+const char* getScanKernelName(ScanKernel kernel);
+
+// Lowercases `length` ASCII bytes into `dst` (which must have room for length + 16).
+// `readable` is how many bytes may be read from `src`, allowing whole-vector loads.
+void lowercaseAscii(const char* src, size_t length, size_t readable, char* dst);
+
+// Splits text on whitespace and reduces every word to its lowercase alphanumeric
+// characters, the same terms the old getline/istringstream/cleanWord path produced.
+// Words that are already clean are handed out as views into the input; only the
+// others are rewritten, into a buffer that is reused for every token.
+class Tokenizer {
+private:
+    static constexpr size_t BATCH_SIZE = 256;
+
+    ScanFunction scan;
+    std::array<TokenSpan, BATCH_SIZE> spans;
+    std::string buffer;
+
+public:
+    explicit Tokenizer(ScanKernel kernel = ScanKernel::Auto) : scan(resolveScanKernel(kernel)) {}
+
+    template <typename Callback>
+    void tokenize(std::string_view text, Callback&& onToken) {
+        size_t pos = 0;
+        while (size_t count = scan(text, pos, spans.data(), BATCH_SIZE)) {
+            for (size_t i = 0; i < count; ++i) {
+                const TokenSpan& span = spans[i];
+                const char* start = text.data() + span.begin;
+
+                if (span.flags == CHAR_CLEAN) {
+                    onToken(std::string_view(start, span.length));
+                } else if (span.flags == CHAR_UPPER) {
+                    if (buffer.size() < span.length + 16) {
+                        buffer.resize(span.length + 16);
+                    }
+                    lowercaseAscii(start, span.length, text.size() - span.begin, buffer.data());
+                    onToken(std::string_view(buffer.data(), span.length));
+                } else {
+                    size_t length = 0;
+                    if (buffer.size() < span.length) {
+                        buffer.resize(span.length);
+                    }
+                    for (size_t k = 0; k < span.length; ++k) {
+                        char folded = charTables.fold[static_cast<unsigned char>(start[k])];
+                        buffer[length] = folded;
+                        length += folded != 0;
+                    }
+                    if (length > 0) {
+                        onToken(std::string_view(buffer.data(), length));
+                    }
+                }
+            }
+        }
+    }
+};
+
+// Per-document term counts keyed by views, in an open-addressing table with linear
+// probing. Keys that point into `stable` text (usually the mapped file) are used as
+// they are; any other key is copied once, on first sight, into an arena.
+// reset() empties the table for the next document but keeps its slots, entries and
+// arena, so a counter reused by one worker stops allocating after its largest document.
+class TermCounter {
+public:
+    struct Entry {
+        std::string_view term;
+        int count;
+    };
+
+private:
+    struct Slot {
+        uint32_t hash = 0;
+        uint32_t entry = 0; // index into entries + 1; 0 marks an empty slot
+    };
+
+    std::string_view stable;
+    std::vector<Slot> slots;     // power-of-two size, at most half full
+    std::vector<Entry> entries;  // in first-seen order
+    std::vector<uint32_t> used;  // occupied slot indices, for a reset in O(entries)
+    Arena arena;
+
+    bool isStable(std::string_view term) const {
+        return term.data() >= stable.data() &&
+               term.data() + term.size() <= stable.data() + stable.size();
+    }
+
+    static uint32_t hashTerm(std::string_view term) {
+        return static_cast<uint32_t>(std::hash<std::string_view>{}(term));
+    }
+
+    void insertSlot(uint32_t hash, uint32_t entry) {
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        while (slots[i].entry != 0) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = { hash, entry };
+        used.push_back(static_cast<uint32_t>(i));
+    }
+
+    void grow() {
+        std::vector<Slot> old(std::max<size_t>(slots.size() * 2, 64));
+        old.swap(slots);
+        used.clear();
+        for (const Slot& slot : old) {
+            if (slot.entry != 0) {
+                insertSlot(slot.hash, slot.entry);
+            }
+        }
+    }
+
+public:
+    explicit TermCounter(std::string_view stableText = {}) : stable(stableText) {}
+
+    void add(std::string_view term, int count = 1) {
+        if ((entries.size() + 1) * 2 > slots.size()) {
+            grow();
+        }
+        uint32_t hash = hashTerm(term);
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.entry == 0) {
+                break;
+            }
+            if (slot.hash == hash && entries[slot.entry - 1].term == term) {
+                entries[slot.entry - 1].count += count;
+                return;
+            }
+        }
+        if (!isStable(term)) {
+            term = arena.copy(term);
+        }
+        entries.push_back({ term, count });
+        insertSlot(hash, static_cast<uint32_t>(entries.size()));
+    }
+
+    // Forgets every count; `stableText` is the text of the next document
+    void reset(std::string_view stableText = {}) {
+        for (uint32_t i : used) {
+            slots[i] = Slot();
+        }
+        used.clear();
+        entries.clear();
+        arena.reset();
+        stable = stableText;
+    }
+
+    const std::vector<Entry>& getCounts() const { return entries; }
+    size_t size() const { return entries.size(); }
+};
+
+// Per-document counts keyed by 32-bit ids that are already well spread (the
+// buckets of a hashed dictionary), so the id itself picks the slot. Same table
+// layout and reuse as TermCounter, without keys to compare or copy.
+class IdCounter {
+public:
+    struct Entry {
+        uint32_t id;
+        int count;
+    };
+
+private:
+    struct Slot {
+        uint32_t id = 0;
+        uint32_t entry = 0; // index into entries + 1; 0 marks an empty slot
+    };
+
+    std::vector<Slot> slots;     // power-of-two size, at most half full
+    std::vector<Entry> entries;  // in first-seen order
+    std::vector<uint32_t> used;  // occupied slot indices, for a reset in O(entries)
+
+    void insertSlot(uint32_t id, uint32_t entry) {
+        size_t mask = slots.size() - 1;
+        size_t i = id & mask;
+        while (slots[i].entry != 0) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = { id, entry };
+        used.push_back(static_cast<uint32_t>(i));
+    }
+
+    void grow() {
+        std::vector<Slot> old(std::max<size_t>(slots.size() * 2, 64));
+        old.swap(slots);
+        used.clear();
+        for (const Slot& slot : old) {
+            if (slot.entry != 0) {
+                insertSlot(slot.id, slot.entry);
+            }
+        }
+    }
+
+public:
+    void add(uint32_t id, int count = 1) {
+        if ((entries.size() + 1) * 2 > slots.size()) {
+            grow();
+        }
+        size_t mask = slots.size() - 1;
+        size_t i = id & mask;
+        while (slots[i].entry != 0 && slots[i].id != id) {
+            i = (i + 1) & mask;
+        }
+        if (slots[i].entry != 0) {
+            entries[slots[i].entry - 1].count += count;
+            return;
+        }
+        entries.push_back({ id, count });
+        slots[i] = { id, static_cast<uint32_t>(entries.size()) };
+        used.push_back(static_cast<uint32_t>(i));
+    }
+
+    void reset() {
+        for (uint32_t i : used) {
+            slots[i] = Slot();
+        }
+        used.clear();
+        entries.clear();
+    }
+
+    const std::vector<Entry>& getCounts() const { return entries; }
+    size_t size() const { return entries.size(); }
+};
+
+#endif // TOKENIZER_H_
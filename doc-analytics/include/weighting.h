@@ -0,0 +1,136 @@
+#ifndef WEIGHTING_H_
+#define WEIGHTING_H_
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Per-document inputs a TF policy may use besides the raw count
+struct DocumentShape {
+    int64_t length = 0;     // total terms in the document
+    int maxFrequency = 0;   // highest count of any term (only filled for policies that need it)
+};
+
+// Corpus-wide inputs a TF policy may use
+struct CorpusShape {
+    size_t documents = 0;
+    double averageLength = 0; // mean DocumentShape::length (only filled for policies that need it)
+};
+
+// TF policies: double operator()(count, document, corpus). The NEEDS_* flags tell
+// TFIDFMatrix which inputs to gather; a policy that needs the average length makes
+// every value depend on the whole corpus, so update() falls back to compute().
+
+// count / document length (the original formula)
+struct RelativeTF {
+    static constexpr bool NEEDS_MAX_FREQUENCY = false;
+    static constexpr bool NEEDS_AVERAGE_LENGTH = false;
+
+    double operator()(int freq, const DocumentShape& doc, const CorpusShape&) const {
+        return static_cast<double>(freq) / doc.length;
+    }
+};
+
+// The count itself
+struct RawTF {
+    static constexpr bool NEEDS_MAX_FREQUENCY = false;
+    static constexpr bool NEEDS_AVERAGE_LENGTH = false;
+
+    double operator()(int freq, const DocumentShape&, const CorpusShape&) const {
+        return freq;
+    }
+};
+
+// Sublinear: 1 + log(count)
+struct LogTF {
+    static constexpr bool NEEDS_MAX_FREQUENCY = false;
+    static constexpr bool NEEDS_AVERAGE_LENGTH = false;
+
+    double operator()(int freq, const DocumentShape&, const CorpusShape&) const {
+        return 1.0 + std::log(static_cast<double>(freq));
+    }
+};
+
+// 0.5 + 0.5 * count / max count, which damps the bias towards long documents
+struct AugmentedTF {
+    static constexpr bool NEEDS_MAX_FREQUENCY = true;
+    static constexpr bool NEEDS_AVERAGE_LENGTH = false;
+
+    double operator()(int freq, const DocumentShape& doc, const CorpusShape&) const {
+        return 0.5 + 0.5 * freq / doc.maxFrequency;
+    }
+};
+
+// Okapi BM25 saturation: count * (k1 + 1) / (count + k1 * (1 - b + b * length / average length))
+struct BM25TF {
+    static constexpr bool NEEDS_MAX_FREQUENCY = false;
+    static constexpr bool NEEDS_AVERAGE_LENGTH = true;
+
+    double k1 = 1.2;
+    double b = 0.75;
+
+    double operator()(int freq, const DocumentShape& doc, const CorpusShape& corpus) const {
+        double lengthRatio = corpus.averageLength > 0 ? doc.length / corpus.averageLength : 1.0;
+        return freq * (k1 + 1) / (freq + k1 * (1 - b + b * lengthRatio));
+    }
+};
+
+// IDF policies: double operator()(document frequency > 0, live documents)
+
+// log(N / df): zero for terms found in every document (the original formula)
+struct StandardIDF {
+    double operator()(int docFreq, size_t totalDocs) const {
+        return std::log(static_cast<double>(totalDocs) / docFreq);
+    }
+};
+
+// log((1 + N) / (1 + df)) + 1: never zero, as if one extra document held every term
+struct SmoothIDF {
+    double operator()(int docFreq, size_t totalDocs) const {
+        return std::log((1.0 + totalDocs) / (1.0 + docFreq)) + 1.0;
+    }
+};
+
+// log((N - df) / df), clamped at zero for terms in more than half of the documents
+struct ProbabilisticIDF {
+    double operator()(int docFreq, size_t totalDocs) const {
+        double remaining = static_cast<double>(totalDocs) - docFreq;
+        return remaining > docFreq ? std::log(remaining / docFreq) : 0.0;
+    }
+};
+
+// BM25 / Lucene form: log(1 + (N - df + 0.5) / (df + 0.5)), always positive
+struct BM25IDF {
+    double operator()(int docFreq, size_t totalDocs) const {
+        return std::log(1.0 + (totalDocs - docFreq + 0.5) / (docFreq + 0.5));
+    }
+};
+
+// Scores are used as computed
+struct NoNormalization {
+    static constexpr bool ENABLED = false;
+};
+
+// Every document's score vector is scaled to unit Euclidean length
+struct L2Normalization {
+    static constexpr bool ENABLED = true;
+};
+
+// A complete weighting: score(term, doc) = tf(count, doc, corpus) * idf(df, N),
+// optionally normalized per document. Policies are plain values, so parameters
+// such as BM25's k1 and b are set on the instance passed to TFIDFMatrix.
+template <typename TFPolicy, typename IDFPolicy, typename Normalization = NoNormalization>
+struct WeightingScheme {
+    using TF = TFPolicy;
+    using IDF = IDFPolicy;
+    using Norm = Normalization;
+
+    TFPolicy tf;
+    IDFPolicy idf;
+};
+
+using ClassicTFIDF = WeightingScheme<RelativeTF, StandardIDF>;
+using SublinearTFIDF = WeightingScheme<LogTF, SmoothIDF, L2Normalization>;
+using BM25Weighting = WeightingScheme<BM25TF, BM25IDF>;
+
+#endif // WEIGHTING_H_
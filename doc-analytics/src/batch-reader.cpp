@@ -0,0 +1,447 @@
+#include "batch-reader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define DOC_ANALYTICS_HAS_PREAD 1
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+// IORING_FEAT_CUR_PERSONALITY arrived with the 5.6 headers, as did OPENAT, READ and CLOSE
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_CUR_PERSONALITY)
+#define DOC_ANALYTICS_HAS_IO_URING 1
+#endif
+#endif
+
+namespace {
+
+constexpr size_t FIRST_READ = 16 << 10;
+// Linux transfers at most this much in one read, whatever the file size
+constexpr size_t MAX_READ = 0x7ffff000;
+constexpr uint64_t CLOSE_TAG = ~uint64_t(0); // user_data of closes, whose results are ignored
+
+// Resizes a file's buffer; a file too large for memory fails alone instead of
+// throwing out of the reader
+bool growBuffer(std::string& text, size_t size, const std::string& path) {
+    try {
+        text.resize(size);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Could not read " << path << ": " << e.what() << "\n";
+        return false;
+    }
+}
+
+// Room to add to a full buffer: 16 KB first, then doubling, in steps one read can fill
+size_t growthFor(size_t length) {
+    return length == 0 ? FIRST_READ : std::min(length, MAX_READ);
+}
+
+} // namespace
+
+const char* getReadBackendName(ReadBackend backend) {
+    switch (backend) {
+        case ReadBackend::Auto: return "auto";
+        case ReadBackend::IoUring: return "io_uring";
+        case ReadBackend::Pread: return "pread";
+    }
+    return "unknown";
+}
+
+struct BatchReader::Slot {
+    enum class Stage { Free, Opening, Reading };
+
+    std::string path;
+    std::string text;
+    Stage stage = Stage::Free;
+    int fd = -1;
+    size_t length = 0; // bytes read so far
+};
+
+#ifdef DOC_ANALYTICS_HAS_IO_URING
+
+// Submission and completion rings shared with the kernel, driven through the raw
+// system calls. We are the only producer of the submission ring and the only
+// consumer of the completion ring; the kernel's side is read with acquire loads.
+struct BatchReader::Ring {
+    int fd = -1;
+    void* sqMap = MAP_FAILED;
+    size_t sqMapSize = 0;
+    void* cqMap = MAP_FAILED;
+    size_t cqMapSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned toSubmit = 0;
+    unsigned closing = 0; // closes queued or in flight
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) {
+            ::munmap(sqes, sqesSize);
+        }
+        if (cqMap != MAP_FAILED && cqMap != sqMap) {
+            ::munmap(cqMap, cqMapSize);
+        }
+        if (sqMap != MAP_FAILED) {
+            ::munmap(sqMap, sqMapSize);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    // Opening, reading and closing all have to be supported (Linux 5.6+)
+    bool supportsFileOps() {
+        constexpr unsigned OP_COUNT = 256;
+        std::vector<unsigned char> buffer(sizeof(io_uring_probe) + OP_COUNT * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, OP_COUNT) < 0) {
+            return false;
+        }
+        for (unsigned op : { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE }) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool setup(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return false;
+        }
+
+        sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+        }
+        sqMap = ::mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED) {
+            return false;
+        }
+        cqMap = singleMap ? sqMap
+                          : ::mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqMap == MAP_FAILED) {
+            return false;
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(
+            ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+
+        auto* sq = static_cast<char*>(sqMap);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto* cq = static_cast<char*>(cqMap);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return supportsFileOps();
+    }
+
+    // Hands queued entries to the kernel, optionally waiting for one completion
+    bool enter(bool wait) {
+        unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+        while (true) {
+            long submitted = ::syscall(__NR_io_uring_enter, fd, toSubmit, wait ? 1 : 0, flags, nullptr, 0);
+            if (submitted >= 0) {
+                toSubmit -= static_cast<unsigned>(submitted);
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                return false;
+            }
+        }
+    }
+
+    io_uring_sqe* nextSqe() {
+        unsigned tail = *sqTail;
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+            enter(false);
+        }
+        unsigned index = tail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        return sqe;
+    }
+
+    void push() {
+        __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+        toSubmit++;
+    }
+};
+
+#else
+
+struct BatchReader::Ring {
+    bool setup(unsigned) { return false; }
+};
+
+#endif // DOC_ANALYTICS_HAS_IO_URING
+
+BatchReader::BatchReader(ReadBackend readBackend, size_t maxInFlight)
+    : backend(ReadBackend::Pread), depth(std::max<size_t>(maxInFlight, 1)) {
+    if (readBackend == ReadBackend::IoUring) {
+        ring = std::make_unique<Ring>();
+        if (ring->setup(static_cast<unsigned>(depth))) {
+            backend = ReadBackend::IoUring;
+            slots.resize(depth);
+            for (size_t i = depth; i-- > 0;) {
+                freeSlots.push_back(i);
+            }
+        } else {
+            std::cerr << "Warning: io_uring is not available, reading with pread\n";
+            ring.reset();
+        }
+    }
+}
+
+BatchReader::~BatchReader() {
+#ifdef DOC_ANALYTICS_HAS_IO_URING
+    // Drain whatever is still in flight so the kernel is done with our buffers and
+    // every descriptor is closed
+    while (ring && (!isIdle() || ring->closing > 0) && ring->enter(true)) {
+        completeRing([](std::string&, std::string&) {}, false);
+    }
+#endif
+}
+
+size_t BatchReader::getInFlight() const {
+    return backend == ReadBackend::IoUring ? depth - freeSlots.size() : pending.size();
+}
+
+void BatchReader::submit(std::string path) {
+    if (backend == ReadBackend::Pread) {
+        pending.push_back(std::move(path));
+        return;
+    }
+    size_t slot = freeSlots.back();
+    freeSlots.pop_back();
+    slots[slot].path = std::move(path);
+    queueOpen(slot);
+}
+
+size_t BatchReader::complete(const Callback& onFile, bool wait) {
+    return backend == ReadBackend::IoUring ? completeRing(onFile, wait) : completePread(onFile);
+}
+
+void BatchReader::readAll(const std::vector<std::string>& paths, const Callback& onFile) {
+    for (const auto& path : paths) {
+        // A completion may be an open or a close, so one wait does not always free a slot
+        while (isFull()) {
+            complete(onFile);
+        }
+        submit(path);
+    }
+    while (!isIdle()) {
+        complete(onFile);
+    }
+}
+
+void BatchReader::finish(size_t slot, const Callback& onFile) {
+    Slot& file = slots[slot];
+    file.text.resize(file.length);
+    onFile(file.path, file.text);
+    file.stage = Slot::Stage::Free;
+    file.path.clear();
+    file.text = std::string();
+    freeSlots.push_back(slot);
+}
+
+#ifdef DOC_ANALYTICS_HAS_IO_URING
+
+void BatchReader::queueOpen(size_t slot) {
+    Slot& file = slots[slot];
+    file.stage = Slot::Stage::Opening;
+    file.length = 0;
+    io_uring_sqe* sqe = ring->nextSqe();
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uint64_t>(file.path.c_str());
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = slot;
+    ring->push();
+}
+
+bool BatchReader::queueRead(size_t slot) {
+    Slot& file = slots[slot];
+    file.stage = Slot::Stage::Reading;
+    if (file.length == file.text.size() &&
+        !growBuffer(file.text, file.length + growthFor(file.length), file.path)) {
+        return false;
+    }
+    io_uring_sqe* sqe = ring->nextSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = file.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(file.text.data() + file.length);
+    sqe->len = static_cast<uint32_t>(std::min(file.text.size() - file.length, MAX_READ));
+    sqe->off = file.length;
+    sqe->user_data = slot;
+    ring->push();
+    return true;
+}
+
+void BatchReader::queueClose(int fd) {
+    io_uring_sqe* sqe = ring->nextSqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = CLOSE_TAG;
+    ring->push();
+    ring->closing++;
+}
+
+size_t BatchReader::completeRing(const Callback& onFile, bool wait) {
+    size_t finished = 0;
+    do {
+        if (!ring->enter(wait && (!isIdle() || ring->closing > 0))) {
+            std::cerr << "Error: io_uring_enter failed: " << std::strerror(errno) << "\n";
+            return finished;
+        }
+        finished += reapRing(onFile);
+        // Once the last file is done no later call would send its close: finish them here
+        wait = true;
+    } while (isIdle() && ring->closing > 0);
+    return finished;
+}
+
+size_t BatchReader::reapRing(const Callback& onFile) {
+    size_t finished = 0;
+    unsigned head = *ring->cqHead;
+    unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = ring->cqes[head & ring->cqMask];
+        if (cqe.user_data == CLOSE_TAG) {
+            ring->closing--;
+            continue;
+        }
+        size_t slot = static_cast<size_t>(cqe.user_data);
+        Slot& file = slots[slot];
+        bool ok = cqe.res >= 0;
+        if (!ok) {
+            std::cerr << "Warning: Could not " << (file.stage == Slot::Stage::Opening ? "open " : "read ")
+                      << file.path << ": " << std::strerror(-cqe.res) << "\n";
+        } else if (file.stage == Slot::Stage::Opening) {
+            file.fd = cqe.res;
+            ok = queueRead(slot);
+        } else if (cqe.res > 0) {
+            // Reads can come back short before the end (at MAX_READ, or on some file
+            // systems), so only an empty one ends the file
+            file.length += static_cast<size_t>(cqe.res);
+            ok = queueRead(slot);
+        } else {
+            queueClose(file.fd);
+            file.fd = -1;
+            finish(slot, onFile);
+            finished++;
+        }
+        if (!ok) {
+            if (file.fd >= 0) {
+                queueClose(file.fd);
+                file.fd = -1;
+            }
+            file.stage = Slot::Stage::Free;
+            file.path.clear();
+            file.text = std::string();
+            freeSlots.push_back(slot);
+            failed++;
+        }
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    return finished;
+}
+
+#else
+
+void BatchReader::queueOpen(size_t) {}
+bool BatchReader::queueRead(size_t) { return false; }
+void BatchReader::queueClose(int) {}
+size_t BatchReader::completeRing(const Callback&, bool) { return 0; }
+size_t BatchReader::reapRing(const Callback&) { return 0; }
+
+#endif // DOC_ANALYTICS_HAS_IO_URING
+
+size_t BatchReader::completePread(const Callback& onFile) {
+    size_t finished = 0;
+    for (auto& path : pending) {
+        std::string text;
+#ifdef DOC_ANALYTICS_HAS_PREAD
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "Warning: Could not open " << path << ": " << std::strerror(errno) << "\n";
+            failed++;
+            continue;
+        }
+        size_t length = 0;
+        bool ok = true;
+        while (true) {
+            if (length == text.size() && !growBuffer(text, length + growthFor(length), path)) {
+                ok = false;
+                break;
+            }
+            size_t requested = std::min(text.size() - length, MAX_READ);
+            ssize_t got = ::pread(fd, text.data() + length, requested, static_cast<off_t>(length));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got < 0) {
+                std::cerr << "Warning: Could not read " << path << ": " << std::strerror(errno) << "\n";
+                ok = false;
+                break;
+            }
+            // Only an empty read is the end; a short one may just be capped
+            if (got == 0) {
+                break;
+            }
+            length += static_cast<size_t>(got);
+        }
+        ::close(fd);
+        if (!ok) {
+            failed++;
+            continue;
+        }
+        text.resize(length);
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Warning: Could not open " << path << "\n";
+            failed++;
+            continue;
+        }
+        text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+#endif
+        onFile(path, text);
+        finished++;
+    }
+    pending.clear();
+    return finished;
+}
@@ -0,0 +1,88 @@
+#include "compact-postings.h"
+
+CompactPostings::CompactPostings(const PostingsSource& source, ScoreStorage scoreStorage,
+                                 DocIdEncoding docEncoding)
+    : storage(scoreStorage), docIdEncoding(docEncoding), terms(source.getHashBits()) {
+    size_t termCount = source.getTermCount();
+    size_t docCount = source.getDocumentCount();
+    size_t valueSize = getScoreSize(storage);
+
+    // Lookup data is copied so the source can go away; a hashed vocabulary has no text
+    if (!terms.isHashed()) {
+        for (TermId term = 0; term < termCount; ++term) {
+            terms.intern(source.getTerm(term));
+        }
+    }
+    idf.resize(termCount);
+    for (TermId term = 0; term < termCount; ++term) {
+        idf[term] = source.getIDF(term);
+    }
+    nameOffsets.assign(docCount + 1, 0);
+    for (DocId doc = 0; doc < docCount; ++doc) {
+        std::string_view name = source.getDocumentName(doc);
+        names.insert(names.end(), name.begin(), name.end());
+        nameOffsets[doc + 1] = names.size();
+    }
+
+    offsets.assign(termCount + 1, 0);
+    for (TermId term = 0; term < termCount; ++term) {
+        offsets[term + 1] = offsets[term] + source.getPostings(term).size;
+    }
+    if (docIdEncoding == DocIdEncoding::Plain) {
+        docs.reserve(offsets.back());
+    }
+    docOffsets.assign(termCount + 1, 0);
+    values.resize(offsets.back() * valueSize);
+    scales.assign(termCount, 1.0);
+
+    std::vector<uint32_t> termDocs;
+    std::vector<double> decoded;
+    for (TermId term = 0; term < termCount; ++term) {
+        termDocs.clear();
+        decoded.clear();
+        forEachPosting(source, term, [&](DocId doc, double value) {
+            termDocs.push_back(doc);
+            decoded.push_back(value);
+        });
+        if (docIdEncoding == DocIdEncoding::Packed) {
+            encodeDocIds(termDocs.data(), termDocs.size(), docs);
+        } else {
+            docs.insert(docs.end(), termDocs.begin(), termDocs.end());
+        }
+        docOffsets[term + 1] = docs.size();
+        scales[term] = encodeScores(decoded.data(), decoded.size(), storage,
+                                    values.data() + offsets[term] * valueSize);
+    }
+    docs.shrink_to_fit();
+}
+
+std::optional<TermId> CompactPostings::findTerm(std::string_view term) const {
+    auto id = terms.find(term);
+    if (id && *id >= idf.size()) {
+        return std::nullopt;
+    }
+    return id;
+}
+
+std::string_view CompactPostings::getTerm(TermId term) const {
+    return terms.getTerm(term);
+}
+
+std::string_view CompactPostings::getDocumentName(DocId doc) const {
+    return std::string_view(names.data() + nameOffsets[doc], nameOffsets[doc + 1] - nameOffsets[doc]);
+}
+
+PostingsList CompactPostings::getPostings(TermId term) const {
+    uint64_t begin = offsets[term];
+    PostingsList postings;
+    postings.values = values.data() + begin * getScoreSize(storage);
+    postings.size = static_cast<size_t>(offsets[term + 1] - begin);
+    postings.scale = scales[term];
+    const uint32_t* termDocs = docs.data() + docOffsets[term];
+    if (docIdEncoding == DocIdEncoding::Packed) {
+        postings.packedDocs = termDocs;
+    } else {
+        postings.docs = termDocs;
+    }
+    return postings;
+}
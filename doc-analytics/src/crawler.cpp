@@ -0,0 +1,293 @@
+#include "crawler.h"
+
+#include <chrono>
+#include <thread>
+
+namespace {
+
+int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+void CrawlPipeline::StageCounters::add(uint64_t itemBytes, uint64_t nanos) {
+    items.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(itemBytes, std::memory_order_relaxed);
+    busyNanos.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+CrawlPipeline::CrawlPipeline(std::shared_ptr<DocumentCollection> coll, const CrawlOptions& opts)
+    : collection(coll), options(opts),
+      paths(opts.pathQueueSize), texts(opts.textQueueSize, opts.textQueueBytes),
+      documents(opts.documentQueueSize) {
+    options.discoveryThreads = std::max<size_t>(options.discoveryThreads, 1);
+    options.readerThreads = std::max<size_t>(options.readerThreads, 1);
+    options.tokenizerThreads = std::max<size_t>(options.tokenizerThreads, 1);
+    // Every file is counted whole on a tokenizer thread
+    options.processing.pool = nullptr;
+}
+
+bool CrawlPipeline::matches(const fs::path& path) const {
+    if (options.extensions.empty()) {
+        return true;
+    }
+    std::string extension = path.extension().string();
+    return std::find(options.extensions.begin(), options.extensions.end(), extension) !=
+           options.extensions.end();
+}
+
+void CrawlPipeline::skip(const std::string& item, const std::exception& error) {
+    std::cerr << "Warning: Skipped " << item << ": " << error.what() << "\n";
+    skipped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CrawlPipeline::discover() {
+    while (true) {
+        std::string directory;
+        {
+            std::unique_lock<std::mutex> lock(directoryMtx);
+            directoryAvailable.wait(lock, [this]() { return !directories.empty() || activeDirectories == 0; });
+            if (directories.empty()) {
+                return;
+            }
+            directory = std::move(directories.back());
+            directories.pop_back();
+        }
+
+        // Time spent pushing into a full path queue is backpressure, not listing
+        int64_t start = nowNanos();
+        int64_t pushing = 0;
+        std::error_code ec;
+        fs::directory_iterator it(directory, fs::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const fs::directory_entry& entry = *it;
+            try {
+                std::error_code typeError;
+                if (entry.is_directory(typeError)) {
+                    if (options.recursive && !entry.is_symlink(typeError)) {
+                        std::lock_guard<std::mutex> lock(directoryMtx);
+                        directories.push_back(entry.path().string());
+                        activeDirectories++;
+                        directoryAvailable.notify_one();
+                    }
+                } else if (entry.is_regular_file(typeError) && matches(entry.path())) {
+                    int64_t pushStart = nowNanos();
+                    paths.push(entry.path().string());
+                    pushing += nowNanos() - pushStart;
+                }
+            } catch (const std::exception& e) {
+                skip(entry.path().string(), e);
+            }
+        }
+        if (ec) {
+            std::cerr << "Warning: Could not list " << directory << ": " << ec.message() << "\n";
+            skipped.fetch_add(1, std::memory_order_relaxed);
+        }
+        counters[CrawlStats::Discover].add(0, nowNanos() - start - pushing);
+
+        std::lock_guard<std::mutex> lock(directoryMtx);
+        if (--activeDirectories == 0) {
+            directoryAvailable.notify_all();
+        }
+    }
+}
+
+void CrawlPipeline::read() {
+    BatchReader reader(options.readBackend, options.readDepth);
+    // Time spent pushing into a full text queue is backpressure, not reading
+    int64_t pushing = 0;
+    auto onFile = [&](std::string& path, std::string& text) {
+        size_t bytes = text.size();
+        counters[CrawlStats::Read].add(bytes, 0);
+        int64_t pushStart = nowNanos();
+        std::string name = path; // the item is moved into the queue
+        try {
+            texts.push({ std::move(path), std::move(text) }, bytes);
+        } catch (const std::exception& e) {
+            skip(name, e);
+        }
+        pushing += nowNanos() - pushStart;
+    };
+
+    bool inputOpen = true;
+    while (inputOpen || !reader.isIdle()) {
+        // Top up the reads in flight; block on the path queue only when there are none
+        while (inputOpen && !reader.isFull()) {
+            std::string path;
+            if (reader.isIdle()) {
+                if (!paths.pop(path)) {
+                    inputOpen = false;
+                    break;
+                }
+            } else if (!paths.tryPop(path)) {
+                break;
+            }
+            reader.submit(std::move(path));
+        }
+
+        int64_t start = nowNanos();
+        pushing = 0;
+        reader.complete(onFile);
+        counters[CrawlStats::Read].busyNanos.fetch_add(nowNanos() - start - pushing, std::memory_order_relaxed);
+    }
+    skipped.fetch_add(reader.getFailedCount(), std::memory_order_relaxed);
+}
+
+void CrawlPipeline::tokenize() {
+    FileText file;
+    while (texts.pop(file)) {
+        try {
+            int64_t start = nowNanos();
+            DocumentProcessor processor(file.path, collection, options.processing);
+            DocumentStats doc = processor.processText(file.text);
+            counters[CrawlStats::Tokenize].add(file.text.size(), nowNanos() - start);
+            // The text is no longer needed while this thread waits on a full queue
+            file.text = std::string();
+
+            documents.push(std::move(doc));
+        } catch (const std::exception& e) {
+            skip(file.path, e);
+        }
+    }
+}
+
+void CrawlPipeline::merge() {
+    DocumentStats doc;
+    while (documents.pop(doc)) {
+        try {
+            int64_t start = nowNanos();
+            collection->addDocument(doc);
+            counters[CrawlStats::Merge].add(0, nowNanos() - start);
+        } catch (const std::exception& e) {
+            skip(doc.docName, e);
+        }
+    }
+}
+
+size_t CrawlPipeline::run(const std::vector<std::string>& roots) {
+    if (started) {
+        std::cerr << "Error: A CrawlPipeline runs only once\n";
+        return 0;
+    }
+    started = true;
+    startNanos = nowNanos();
+
+    // Root files are taken whatever their extension
+    std::vector<std::string> rootFiles;
+    for (const auto& root : roots) {
+        std::error_code ec;
+        if (fs::is_directory(root, ec)) {
+            directories.push_back(root);
+            activeDirectories++;
+        } else if (fs::is_regular_file(root, ec)) {
+            rootFiles.push_back(root);
+        } else {
+            std::cerr << "Warning: Could not open " << root << "\n";
+            skipped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    auto spawn = [](size_t count, std::vector<std::thread>& threads, auto&& body) {
+        for (size_t i = 0; i < count; ++i) {
+            threads.emplace_back(body);
+        }
+    };
+    std::vector<std::thread> discoverers, readers, tokenizers, mergers;
+    spawn(options.discoveryThreads, discoverers, [this]() { discover(); });
+    spawn(options.readerThreads, readers, [this]() { read(); });
+    spawn(options.tokenizerThreads, tokenizers, [this]() { tokenize(); });
+    spawn(1, mergers, [this]() { merge(); });
+
+    for (auto& path : rootFiles) {
+        paths.push(std::move(path));
+    }
+
+    // Each stage ends once the one before it has ended and its queue is drained
+    auto finish = [](std::vector<std::thread>& threads) {
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+    finish(discoverers);
+    paths.close();
+    finish(readers);
+    texts.close();
+    finish(tokenizers);
+    documents.close();
+    finish(mergers);
+
+    endNanos = nowNanos();
+    return counters[CrawlStats::Merge].items.load();
+}
+
+CrawlStats CrawlPipeline::getStats() const {
+    CrawlStats stats;
+    const char* names[] = { "discover", "read", "tokenize", "merge" };
+    const size_t threads[] = { options.discoveryThreads, options.readerThreads, options.tokenizerThreads, 1 };
+    for (size_t i = 0; i < stats.stages.size(); ++i) {
+        CrawlStageStats& stage = stats.stages[i];
+        stage.name = names[i];
+        stage.threads = threads[i];
+        stage.items = counters[i].items.load(std::memory_order_relaxed);
+        stage.bytes = counters[i].bytes.load(std::memory_order_relaxed);
+        stage.busyNanos = counters[i].busyNanos.load(std::memory_order_relaxed);
+    }
+
+    stats.queues = { paths.snapshot(), texts.snapshot(), documents.snapshot() };
+    for (size_t i = 0; i < stats.queues.size(); ++i) {
+        // Queue i sits between stage i and stage i + 1
+        stats.stages[i].blockedNanos = stats.queues[i].pushWaitNanos;
+        stats.stages[i + 1].starvedNanos = stats.queues[i].popWaitNanos;
+    }
+
+    stats.skipped = skipped.load(std::memory_order_relaxed);
+    int64_t start = startNanos.load();
+    if (start != 0) {
+        int64_t end = endNanos.load();
+        stats.seconds = ((end != 0 ? end : nowNanos()) - start) / 1e9;
+    }
+    return stats;
+}
+
+void CrawlPipeline::printStats() const {
+    CrawlStats stats = getStats();
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+
+    std::cout << "Crawl: " << stats.stages[CrawlStats::Merge].items << " documents in "
+              << std::fixed << std::setprecision(3) << stats.seconds << " s";
+    if (stats.skipped > 0) {
+        std::cout << ", " << stats.skipped << " skipped";
+    }
+    std::cout << "\n";
+
+    std::cout << std::left << std::setw(10) << "stage" << std::right << std::setw(8) << "threads"
+              << std::setw(10) << "items" << std::setw(12) << "items/s" << std::setw(10) << "MB/s"
+              << std::setw(10) << "busy s" << std::setw(11) << "starved s" << std::setw(11) << "blocked s" << "\n";
+    double seconds = std::max(stats.seconds, 1e-9);
+    for (const auto& stage : stats.stages) {
+        std::cout << std::left << std::setw(10) << stage.name << std::right << std::setw(8) << stage.threads
+                  << std::setw(10) << stage.items
+                  << std::setprecision(0) << std::setw(12) << stage.items / seconds
+                  << std::setprecision(2) << std::setw(10) << stage.bytes / 1048576.0 / seconds
+                  << std::setprecision(3) << std::setw(10) << stage.busyNanos / 1e9
+                  << std::setw(11) << stage.starvedNanos / 1e9
+                  << std::setw(11) << stage.blockedNanos / 1e9 << "\n";
+    }
+
+    const char* queueNames[] = { "paths", "texts", "documents" };
+    std::cout << "Queue peaks:";
+    for (size_t i = 0; i < stats.queues.size(); ++i) {
+        std::cout << " " << queueNames[i] << " " << stats.queues[i].peak << "/" << stats.queues[i].capacity;
+        if (stats.queues[i].byteCapacity > 0) {
+            std::cout << std::setprecision(1) << " (" << stats.queues[i].peakBytes / 1048576.0 << "/"
+                      << stats.queues[i].byteCapacity / 1048576.0 << " MB)";
+        }
+    }
+    std::cout << "\n";
+
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
@@ -0,0 +1,197 @@
+#include "index-file.h"
+
+IndexFile::IndexFile(const std::string& path) : file(path) {
+    if (!file.isOpen()) {
+        std::cerr << "Error: Could not open index " << path << "\n";
+        return;
+    }
+    if (!validate(path)) {
+        header = nullptr;
+    }
+}
+
+bool IndexFile::validate(const std::string& path) {
+    std::string_view data = file.data();
+    if (data.size() < sizeof(IndexHeader)) {
+        std::cerr << "Error: " << path << " is too small to be an index\n";
+        return false;
+    }
+
+    header = section<IndexHeader>(0);
+    if (std::memcmp(header->magic, IndexHeader::MAGIC, sizeof(IndexHeader::MAGIC)) != 0) {
+        std::cerr << "Error: " << path << " is not an index file\n";
+        return false;
+    }
+    if (header->version != IndexHeader::VERSION || header->headerSize != sizeof(IndexHeader)) {
+        std::cerr << "Error: " << path << " has unsupported index version " << header->version << "\n";
+        return false;
+    }
+    if (header->fileSize != data.size()) {
+        std::cerr << "Error: " << path << " is truncated\n";
+        return false;
+    }
+
+    if (header->scoreStorage > static_cast<uint32_t>(ScoreStorage::Quantized8) ||
+        header->docIdEncoding > static_cast<uint32_t>(DocIdEncoding::Packed)) {
+        std::cerr << "Error: " << path << " uses an unknown score or document id encoding\n";
+        return false;
+    }
+
+    uint64_t terms = header->termCount;
+    if (header->hashBits != 0 && (header->hashBits > 30 || terms != uint64_t{1} << header->hashBits)) {
+        std::cerr << "Error: " << path << " has an invalid hashed vocabulary\n";
+        return false;
+    }
+
+    // Every section has to fit in the file; counts past the file size cannot, and
+    // would overflow the size arithmetic below
+    if (terms > data.size() || header->docCount > data.size() || header->nonZeros > data.size()) {
+        std::cerr << "Error: " << path << " has a corrupt section table\n";
+        return false;
+    }
+    uint64_t namedTerms = header->hashBits != 0 ? 0 : terms;
+    uint64_t docs = header->docCount;
+    uint64_t nnz = header->nonZeros;
+    const std::pair<uint64_t, uint64_t> sections[] = {
+        { header->termOffsets,    (namedTerms + 1) * sizeof(uint64_t) },
+        { header->sortedTerms,    namedTerms * sizeof(uint32_t) },
+        { header->docOffsets,     (docs + 1) * sizeof(uint64_t) },
+        { header->docTotals,      docs * sizeof(int64_t) },
+        { header->docFrequency,   terms * sizeof(int32_t) },
+        { header->idf,            terms * sizeof(double) },
+        { header->postingOffsets, (terms + 1) * sizeof(uint64_t) },
+        { header->postingDocOffsets, (terms + 1) * sizeof(uint64_t) },
+        { header->termScales,     terms * sizeof(double) },
+        { header->postingValues,  nnz * getScoreSize(getScoreStorage()) },
+    };
+    for (const auto& [offset, size] : sections) {
+        if (offset % 8 != 0 || offset > data.size() || size > data.size() - offset) {
+            std::cerr << "Error: " << path << " has a corrupt section table\n";
+            return false;
+        }
+    }
+    uint64_t docWords = section<uint64_t>(header->postingDocOffsets)[terms];
+    if (header->postingDocs % 8 != 0 || header->postingDocs > data.size() ||
+        docWords > (data.size() - header->postingDocs) / sizeof(uint32_t) ||
+        header->termChars > data.size() || header->docChars > data.size()) {
+        std::cerr << "Error: " << path << " has a corrupt section table\n";
+        return false;
+    }
+    if (section<uint64_t>(header->postingOffsets)[terms] != nnz ||
+        (getDocIdEncoding() == DocIdEncoding::Plain && docWords != nnz)) {
+        std::cerr << "Error: " << path << " has inconsistent sections\n";
+        return false;
+    }
+
+    // One pass over every offset table: each is non-decreasing and stays inside the
+    // section it points into, so every later lookup is in bounds
+    struct OffsetTable {
+        uint64_t offset;
+        uint64_t entries;
+        uint64_t limit;
+    };
+    const OffsetTable offsetTables[] = {
+        { header->termOffsets,       namedTerms + 1, data.size() - header->termChars },
+        { header->docOffsets,        docs + 1,       data.size() - header->docChars },
+        { header->postingOffsets,    terms + 1,      nnz },
+        { header->postingDocOffsets, terms + 1,      docWords },
+    };
+    for (const OffsetTable& table : offsetTables) {
+        const uint64_t* offsets = section<uint64_t>(table.offset);
+        for (uint64_t i = 0; i < table.entries; ++i) {
+            if (offsets[i] > table.limit || (i > 0 && offsets[i] < offsets[i - 1])) {
+                std::cerr << "Error: " << path << " has inconsistent sections\n";
+                return false;
+            }
+        }
+    }
+    const uint32_t* sortedTerms = section<uint32_t>(header->sortedTerms);
+    for (uint64_t i = 0; i < namedTerms; ++i) {
+        if (sortedTerms[i] >= terms) {
+            std::cerr << "Error: " << path << " has inconsistent sections\n";
+            return false;
+        }
+    }
+
+    // Readers index per-document arrays by posting id, so every list has to hold
+    // ascending ids below docCount; a compressed one is decoded to check that
+    const uint64_t* postingOffsets = section<uint64_t>(header->postingOffsets);
+    const uint64_t* docOffsets = section<uint64_t>(header->postingDocOffsets);
+    const uint32_t* postingDocs = section<uint32_t>(header->postingDocs);
+    for (uint64_t term = 0; term < terms; ++term) {
+        const uint32_t* list = postingDocs + docOffsets[term];
+        uint64_t count = postingOffsets[term + 1] - postingOffsets[term];
+        bool valid = true;
+        if (getDocIdEncoding() == DocIdEncoding::Packed) {
+            valid = checkDocIds(list, docOffsets[term + 1] - docOffsets[term], count, docs);
+        } else {
+            valid = docOffsets[term + 1] - docOffsets[term] == count;
+            for (uint64_t i = 0; i < count && valid; ++i) {
+                valid = list[i] < docs && (i == 0 || list[i] > list[i - 1]);
+            }
+        }
+        if (!valid) {
+            std::cerr << "Error: " << path << " has a corrupt postings list for term " << term << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view IndexFile::getTerm(TermId term) const {
+    if (header->hashBits != 0) {
+        return {};
+    }
+    const uint64_t* offsets = section<uint64_t>(header->termOffsets);
+    return std::string_view(section<char>(header->termChars) + offsets[term],
+                            offsets[term + 1] - offsets[term]);
+}
+
+std::optional<TermId> IndexFile::findTerm(std::string_view term) const {
+    if (header->hashBits != 0) {
+        return TermDictionary::hashTerm(term, header->hashBits);
+    }
+    const uint32_t* sorted = section<uint32_t>(header->sortedTerms);
+    const uint32_t* end = sorted + header->termCount;
+    const uint32_t* it = std::lower_bound(sorted, end, term,
+        [this](uint32_t id, std::string_view value) { return getTerm(id) < value; });
+    if (it == end || getTerm(*it) != term) {
+        return std::nullopt;
+    }
+    return *it;
+}
+
+std::string_view IndexFile::getDocumentName(DocId doc) const {
+    const uint64_t* offsets = section<uint64_t>(header->docOffsets);
+    return std::string_view(section<char>(header->docChars) + offsets[doc],
+                            offsets[doc + 1] - offsets[doc]);
+}
+
+int64_t IndexFile::getTotalTerms(DocId doc) const {
+    return section<int64_t>(header->docTotals)[doc];
+}
+
+int IndexFile::getDocumentFrequency(TermId term) const {
+    return section<int32_t>(header->docFrequency)[term];
+}
+
+double IndexFile::getIDF(TermId term) const {
+    return section<double>(header->idf)[term];
+}
+
+PostingsList IndexFile::getPostings(TermId term) const {
+    const uint64_t* offsets = section<uint64_t>(header->postingOffsets);
+    uint64_t begin = offsets[term];
+    PostingsList postings;
+    postings.values = section<char>(header->postingValues) + begin * getScoreSize(getScoreStorage());
+    postings.size = static_cast<size_t>(offsets[term + 1] - begin);
+    postings.scale = section<double>(header->termScales)[term];
+    const uint32_t* docs = section<uint32_t>(header->postingDocs) +
+                           section<uint64_t>(header->postingDocOffsets)[term];
+    if (getDocIdEncoding() == DocIdEncoding::Packed) {
+        postings.packedDocs = docs;
+    } else {
+        postings.docs = docs;
+    }
+    return postings;
+}
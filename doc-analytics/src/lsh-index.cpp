@@ -0,0 +1,134 @@
+#include "lsh-index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+LSHIndex::LSHIndex(size_t bands, size_t maxBucket) : bandCount(bands), maxBucketSize(maxBucket) {
+    if (bandCount == 0 || MINHASH_SIZE % bandCount != 0) {
+        std::cerr << "Warning: " << bands << " bands do not divide a signature of "
+                  << MINHASH_SIZE << " lanes, using 32\n";
+        bandCount = 32;
+    }
+    rowsPerBand = MINHASH_SIZE / bandCount;
+    buckets.resize(bandCount);
+}
+
+uint64_t LSHIndex::hashBand(const MinHashSignature& signature, size_t band) const {
+    uint64_t hash = band;
+    for (size_t i = band * rowsPerBand; i < (band + 1) * rowsPerBand; ++i) {
+        hash = (hash ^ signature.values[i]) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+void LSHIndex::add(DocId doc, const MinHashSignature& signature) {
+    if (signature.empty()) {
+        return;
+    }
+    if (doc >= signatures.size()) {
+        signatures.resize(doc + 1);
+        indexed.resize(doc + 1, false);
+    }
+    if (indexed[doc]) {
+        std::cerr << "Warning: document " << doc << " is already in the LSH index\n";
+        return;
+    }
+    signatures[doc] = signature;
+    indexed[doc] = true;
+    for (size_t band = 0; band < bandCount; ++band) {
+        buckets[band][hashBand(signature, band)].push_back(doc);
+    }
+}
+
+void LSHIndex::addCollection(const DocumentCollection& collection) {
+    for (DocId docId = 0; docId < collection.getSlotCount(); ++docId) {
+        DocumentView doc = collection.getDocument(docId);
+        if (doc && doc.signature) {
+            add(docId, *doc.signature);
+        }
+    }
+}
+
+std::vector<DocId> LSHIndex::getCandidates(const MinHashSignature& signature) const {
+    std::vector<DocId> candidates;
+    if (signature.empty()) {
+        return candidates;
+    }
+    for (size_t band = 0; band < bandCount; ++band) {
+        auto it = buckets[band].find(hashBand(signature, band));
+        if (it != buckets[band].end()) {
+            candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    return candidates;
+}
+
+std::vector<SimilarPair> LSHIndex::getCandidatePairs(double minSimilarity, ThreadPool* pool,
+                                                     LSHPairStats* stats) const {
+    // Each band lists its colliding pairs as (first << 32 | second) keys; a pair that
+    // collides in several bands is kept once after the merge
+    std::vector<std::vector<uint64_t>> bandPairs(bandCount);
+    std::vector<LSHPairStats> bandStats(bandCount);
+    parallelFor(pool, bandCount, [&](size_t band) {
+        auto& keys = bandPairs[band];
+        std::vector<DocId> sample;
+        for (const auto& [hash, bucket] : buckets[band]) {
+            const std::vector<DocId>* docs = &bucket;
+            if (maxBucketSize > 0 && bucket.size() > maxBucketSize) {
+                sample.clear();
+                for (size_t i = 0; i < maxBucketSize; ++i) {
+                    sample.push_back(bucket[i * bucket.size() / maxBucketSize]);
+                }
+                docs = &sample;
+                uint64_t n = bucket.size();
+                uint64_t m = maxBucketSize;
+                bandStats[band].oversizedBuckets++;
+                bandStats[band].droppedPairs += n * (n - 1) / 2 - m * (m - 1) / 2;
+            }
+            for (size_t i = 0; i < docs->size(); ++i) {
+                for (size_t j = i + 1; j < docs->size(); ++j) {
+                    DocId first = std::min((*docs)[i], (*docs)[j]);
+                    DocId second = std::max((*docs)[i], (*docs)[j]);
+                    keys.push_back(static_cast<uint64_t>(first) << 32 | second);
+                }
+            }
+        }
+    });
+
+    std::vector<uint64_t> keys;
+    LSHPairStats dropped;
+    for (size_t band = 0; band < bandCount; ++band) {
+        keys.insert(keys.end(), bandPairs[band].begin(), bandPairs[band].end());
+        std::vector<uint64_t>().swap(bandPairs[band]);
+        dropped.oversizedBuckets += bandStats[band].oversizedBuckets;
+        dropped.droppedPairs += bandStats[band].droppedPairs;
+    }
+    if (stats) {
+        *stats = dropped;
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::vector<SimilarPair> pairs;
+    for (uint64_t key : keys) {
+        DocId first = static_cast<DocId>(key >> 32);
+        DocId second = static_cast<DocId>(key);
+        double score = estimateJaccard(signatures[first], signatures[second]);
+        if (score >= minSimilarity) {
+            pairs.push_back({ first, second, score });
+        }
+    }
+    return pairs;
+}
+
+double LSHIndex::getThreshold() const {
+    return std::pow(1.0 / bandCount, 1.0 / rowsPerBand);
+}
+
+size_t LSHIndex::size() const {
+    return std::count(indexed.begin(), indexed.end(), true);
+}
@@ -0,0 +1,78 @@
+#include "minhash.h"
+
+namespace {
+
+constexpr uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// One seed per lane; lane i hashes term ^ seeds[i]
+constexpr std::array<uint32_t, MINHASH_SIZE> makeSeeds() {
+    std::array<uint32_t, MINHASH_SIZE> seeds{};
+    uint64_t state = 0x6D696E68617368ull;
+    for (auto& seed : seeds) {
+        seed = static_cast<uint32_t>(splitMix64(state));
+    }
+    return seeds;
+}
+
+constexpr std::array<uint32_t, MINHASH_SIZE> seeds = makeSeeds();
+
+// 64-bit FNV-1a: stable across runs and platforms
+uint64_t hashTerm(std::string_view term) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (unsigned char c : term) {
+        hash = (hash ^ c) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+bool MinHashSignature::empty() const {
+    for (uint32_t value : values) {
+        if (value != UINT32_MAX) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MinHasher::add(std::string_view term) {
+    addHashed(hashTerm(term));
+}
+
+void MinHasher::addHashed(uint64_t termHash) {
+    // Lane i starts from low + i * high of the mixed 64-bit hash (double hashing), so two
+    // terms agree on every lane only if all 64 bits agree; a 32-bit base would make any
+    // 32-bit collision a full-signature collision. Small ids get spread over both halves.
+    uint64_t state = termHash;
+    uint64_t mixed = splitMix64(state);
+    uint32_t low = static_cast<uint32_t>(mixed);
+    uint32_t high = static_cast<uint32_t>(mixed >> 32) | 1;
+    // Murmur3 finalizer per lane; the fixed trip count and branch-free min let the
+    // compiler vectorize this loop
+    for (size_t i = 0; i < MINHASH_SIZE; ++i) {
+        uint32_t h = (low + static_cast<uint32_t>(i) * high) ^ seeds[i];
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        h ^= h >> 16;
+        signature.values[i] = h < signature.values[i] ? h : signature.values[i];
+    }
+}
+
+double estimateJaccard(const MinHashSignature& a, const MinHashSignature& b) {
+    if (a.empty() || b.empty()) {
+        return 0.0;
+    }
+    size_t equal = 0;
+    for (size_t i = 0; i < MINHASH_SIZE; ++i) {
+        equal += a.values[i] == b.values[i];
+    }
+    return static_cast<double>(equal) / MINHASH_SIZE;
+}
@@ -0,0 +1,290 @@
+#include "postings-codec.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define DOC_ANALYTICS_HAS_SSE2 1
+#endif
+
+namespace {
+
+constexpr size_t LANES = 4;
+constexpr size_t LANE_VALUES = DOC_BLOCK_SIZE / LANES;
+
+unsigned bitWidth(uint32_t value) {
+    unsigned bits = 0;
+    while (value) {
+        bits++;
+        value >>= 1;
+    }
+    return bits;
+}
+
+// Writes 128 gaps of `bits` bits as 4 * bits words, lane by lane
+void packBlock(const uint32_t* gaps, unsigned bits, uint32_t* out) {
+    std::fill(out, out + LANES * bits, 0);
+    for (size_t k = 0; k < LANE_VALUES; ++k) {
+        size_t bit = k * bits;
+        size_t word = bit / 32;
+        unsigned shift = bit % 32;
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            uint32_t gap = gaps[k * LANES + lane];
+            out[word * LANES + lane] |= gap << shift;
+            if (shift + bits > 32) {
+                out[(word + 1) * LANES + lane] |= gap >> (32 - shift);
+            }
+        }
+    }
+}
+
+// The inverse of packBlock for a fixed width, followed by the running sum that turns
+// gaps back into ids. Bits is a template parameter so every shift and mask is a constant.
+template <unsigned Bits>
+void unpackBlock(const uint32_t* in, uint32_t* out, uint32_t previous) {
+    constexpr uint32_t mask = Bits == 32 ? ~0u : (1u << Bits) - 1;
+#ifdef DOC_ANALYTICS_HAS_SSE2
+    // Gaps k * 4 .. k * 4 + 3 come out of one 4-lane step, already in list order,
+    // so the prefix sum runs on the same vector: two shifted adds plus the carry
+    const __m128i lowBits = _mm_set1_epi32(static_cast<int>(mask));
+    const __m128i ones = _mm_set1_epi32(1);
+    __m128i carry = _mm_set1_epi32(static_cast<int>(previous));
+    for (size_t k = 0; k < LANE_VALUES; ++k) {
+        __m128i gaps = _mm_setzero_si128();
+        if constexpr (Bits > 0) {
+            size_t bit = k * Bits;
+            size_t word = bit / 32;
+            unsigned shift = bit % 32;
+            __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + word * LANES));
+            gaps = _mm_srl_epi32(current, _mm_cvtsi32_si128(shift));
+            if (shift + Bits > 32) {
+                __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (word + 1) * LANES));
+                gaps = _mm_or_si128(gaps, _mm_sll_epi32(next, _mm_cvtsi32_si128(32 - shift)));
+            }
+            gaps = _mm_and_si128(gaps, lowBits);
+        }
+        __m128i ids = _mm_add_epi32(gaps, ones);
+        ids = _mm_add_epi32(ids, _mm_slli_si128(ids, 4));
+        ids = _mm_add_epi32(ids, _mm_slli_si128(ids, 8));
+        ids = _mm_add_epi32(ids, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k * LANES), ids);
+        carry = _mm_shuffle_epi32(ids, 0xFF);
+    }
+#else
+    for (size_t k = 0; k < LANE_VALUES; ++k) {
+        size_t bit = k * Bits;
+        size_t word = bit / 32;
+        unsigned shift = bit % 32;
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            uint32_t gap = 0;
+            if constexpr (Bits > 0) {
+                gap = in[word * LANES + lane] >> shift;
+                if (shift + Bits > 32) {
+                    gap |= in[(word + 1) * LANES + lane] << (32 - shift);
+                }
+            }
+            previous += (gap & mask) + 1;
+            out[k * LANES + lane] = previous;
+        }
+    }
+#endif
+}
+
+using Unpacker = void (*)(const uint32_t*, uint32_t*, uint32_t);
+
+template <size_t... Bits>
+constexpr std::array<Unpacker, sizeof...(Bits)> makeUnpackers(std::index_sequence<Bits...>) {
+    return { &unpackBlock<Bits>... };
+}
+
+constexpr std::array<Unpacker, 33> unpackers = makeUnpackers(std::make_index_sequence<33>());
+
+} // namespace
+
+void encodeDocIds(const uint32_t* docs, size_t count, std::vector<uint32_t>& out) {
+    size_t fullBlocks = count / DOC_BLOCK_SIZE;
+    size_t listStart = out.size();
+    out.resize(listStart + 2 * (fullBlocks + 1), 0);
+
+    int64_t previous = -1;
+    uint32_t gaps[DOC_BLOCK_SIZE];
+    for (size_t block = 0; block < fullBlocks; ++block) {
+        const uint32_t* ids = docs + block * DOC_BLOCK_SIZE;
+        uint32_t widest = 0;
+        for (size_t i = 0; i < DOC_BLOCK_SIZE; ++i) {
+            gaps[i] = static_cast<uint32_t>(ids[i] - previous - 1);
+            widest |= gaps[i];
+            previous = ids[i];
+        }
+        unsigned bits = bitWidth(widest);
+
+        out[listStart + 2 * block] = ids[DOC_BLOCK_SIZE - 1];
+        out[listStart + 2 * block + 1] = static_cast<uint32_t>(out.size() - listStart);
+        out.push_back(bits);
+        size_t data = out.size();
+        out.resize(data + LANES * bits);
+        packBlock(gaps, bits, out.data() + data);
+    }
+
+    // Tail: varint gaps, byte by byte into zero-padded words
+    out[listStart + 2 * fullBlocks] = count > 0 ? docs[count - 1] : 0;
+    out[listStart + 2 * fullBlocks + 1] = static_cast<uint32_t>(out.size() - listStart);
+    std::vector<uint8_t> bytes;
+    for (size_t i = fullBlocks * DOC_BLOCK_SIZE; i < count; ++i) {
+        uint32_t gap = static_cast<uint32_t>(docs[i] - previous - 1);
+        previous = docs[i];
+        while (gap >= 0x80) {
+            bytes.push_back(static_cast<uint8_t>(gap | 0x80));
+            gap >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(gap));
+    }
+    size_t data = out.size();
+    out.resize(data + (bytes.size() + 3) / 4, 0);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        out[data + i / 4] |= static_cast<uint32_t>(bytes[i]) << (8 * (i % 4));
+    }
+}
+
+bool checkDocIds(const uint32_t* list, size_t words, size_t count, size_t docCount) {
+    size_t fullBlocks = count / DOC_BLOCK_SIZE;
+    size_t skipWords = 2 * (fullBlocks + 1);
+    if (skipWords > words) {
+        return false;
+    }
+    for (size_t block = 0; block < fullBlocks; ++block) {
+        uint32_t offset = list[2 * block + 1];
+        if (offset < skipWords || offset >= words || list[offset] > 32 ||
+            LANES * list[offset] > words - offset - 1) {
+            return false;
+        }
+    }
+
+    // Walk the tail's varints as decodeDocBlock does; a gap takes at most 5 bytes
+    size_t offset = list[2 * fullBlocks + 1];
+    if (offset < skipWords || offset > words) {
+        return false;
+    }
+    size_t bytes = (words - offset) * 4;
+    size_t byte = 0;
+    for (size_t i = fullBlocks * DOC_BLOCK_SIZE; i < count; ++i) {
+        size_t length = 0;
+        uint8_t value;
+        do {
+            if (byte >= bytes || ++length > 5) {
+                return false;
+            }
+            value = static_cast<uint8_t>(list[offset + byte / 4] >> (8 * (byte % 4)));
+            byte++;
+        } while (value & 0x80);
+    }
+
+    // The layout is sound, so decode: ids have to rise strictly from the start (a gap
+    // sum that wraps past UINT32_MAX would fall back) and stay below docCount, and the
+    // skip table has to hold each block's real last id, since seeks and the next
+    // block's decoding start from it
+    alignas(16) uint32_t ids[DOC_BLOCK_SIZE];
+    int64_t previous = -1;
+    for (size_t block = 0; block < getDocBlockCount(count); ++block) {
+        size_t n = decodeDocBlock(list, count, block, ids);
+        for (size_t i = 0; i < n; ++i) {
+            if (ids[i] <= previous || ids[i] >= docCount) {
+                return false;
+            }
+            previous = ids[i];
+        }
+        if (list[2 * block] != previous) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t decodeDocBlock(const uint32_t* list, size_t count, size_t block, uint32_t* out) {
+    size_t fullBlocks = count / DOC_BLOCK_SIZE;
+    uint32_t previous = block > 0 ? list[2 * (block - 1)] : UINT32_MAX; // -1 as uint32
+    const uint32_t* data = list + list[2 * block + 1];
+
+    if (block < fullBlocks) {
+        assert(data[0] <= 32 && "block width out of range; check lists with checkDocIds");
+        unpackers[data[0]](data + 1, out, previous);
+        return DOC_BLOCK_SIZE;
+    }
+
+    size_t n = count - fullBlocks * DOC_BLOCK_SIZE;
+    size_t byte = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t gap = 0;
+        unsigned shift = 0;
+        uint8_t value;
+        do {
+            value = static_cast<uint8_t>(data[byte / 4] >> (8 * (byte % 4)));
+            byte++;
+            gap |= static_cast<uint32_t>(value & 0x7F) << shift;
+            shift += 7;
+        } while (value & 0x80);
+        previous += gap + 1;
+        out[i] = previous;
+    }
+    return n;
+}
+
+DocIdCursor::DocIdCursor(const uint32_t* plainDocs, const uint32_t* packedDocs, size_t size)
+    : plain(plainDocs), packed(packedDocs), count(size), blockCount(getDocBlockCount(size)) {
+    if (blockCount > 0) {
+        load(0);
+    }
+}
+
+uint32_t DocIdCursor::blockLast(size_t b) const {
+    if (packed) {
+        return getDocBlockLast(packed, count, b);
+    }
+    return plain[std::min((b + 1) * DOC_BLOCK_SIZE, count) - 1];
+}
+
+void DocIdCursor::load(size_t b) {
+    block = b;
+    pos = 0;
+    if (packed) {
+        blockSize = decodeDocBlock(packed, count, b, buffer);
+    } else {
+        blockSize = std::min(DOC_BLOCK_SIZE, count - b * DOC_BLOCK_SIZE);
+    }
+}
+
+void DocIdCursor::seek(uint32_t target) {
+    if (done() || doc() >= target) {
+        return;
+    }
+    if (blockLast(block) < target) {
+        // Gallop over the skip table, then binary search the bracketed range
+        size_t low = block + 1;
+        size_t step = 1;
+        size_t high = low;
+        while (high < blockCount && blockLast(high) < target) {
+            low = high + 1;
+            high += step;
+            step *= 2;
+        }
+        high = std::min(high, blockCount);
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (blockLast(mid) < target) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        if (low == blockCount) {
+            pos = blockSize; // past the end
+            return;
+        }
+        load(low);
+    }
+    const uint32_t* begin = ids();
+    pos = std::lower_bound(begin + pos, begin + blockSize, target) - begin;
+}
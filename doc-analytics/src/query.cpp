@@ -0,0 +1,196 @@
+#include "query.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <queue>
+#include "tokenizer.h"
+
+namespace {
+
+// Walks one term's postings during a query
+template <typename Value>
+struct Cursor {
+    DocIdCursor docIds;
+    const Value* values = nullptr;
+    double weight = 0;     // query weight * IDF * decoding scale
+    double upperBound = 0; // query weight * max normalized TF * IDF of the list
+
+    bool done() const { return docIds.done(); }
+    DocId doc() const { return docIds.doc(); }
+    double score() const { return weight * values[docIds.index()]; }
+    void next() { docIds.next(); }
+    // Moves to the first posting >= target, skipping whole blocks where it can
+    void seek(DocId target) { docIds.seek(target); }
+};
+
+// Heap order: the weakest result (lowest score, then highest DocId) on top
+struct WeakerFirst {
+    bool operator()(const SearchResult& a, const SearchResult& b) const {
+        return a.score != b.score ? a.score > b.score : a.doc < b.doc;
+    }
+};
+
+} // namespace
+
+QueryEngine::QueryEngine(const PostingsSource& src) : source(src) {
+    size_t termCount = source.getTermCount();
+    size_t docCount = source.getDocumentCount();
+
+    // Squared norms of every document vector, accumulated term by term
+    std::vector<double> squaredNorm(docCount, 0.0);
+    for (TermId term = 0; term < termCount; ++term) {
+        double idf = source.getIDF(term);
+        forEachPosting(source, term, [&](DocId doc, double tf) {
+            squaredNorm[doc] += (tf * idf) * (tf * idf);
+        });
+    }
+    inverseNorm.resize(docCount);
+    for (DocId doc = 0; doc < docCount; ++doc) {
+        inverseNorm[doc] = squaredNorm[doc] > 0 ? 1.0 / std::sqrt(squaredNorm[doc]) : 0.0;
+    }
+
+    maxWeight.assign(termCount, 0.0);
+    for (TermId term = 0; term < termCount; ++term) {
+        double idf = source.getIDF(term);
+        forEachPosting(source, term, [&](DocId doc, double tf) {
+            maxWeight[term] = std::max(maxWeight[term], tf * idf * inverseNorm[doc]);
+        });
+    }
+}
+
+std::vector<SearchResult> QueryEngine::search(std::string_view query, size_t k) const {
+    if (k == 0) {
+        return {};
+    }
+
+    // Query term frequencies, with the same filtering as documents
+    std::map<TermId, int> queryTerms;
+    Tokenizer tokenizer;
+    tokenizer.tokenize(query, [&](std::string_view term) {
+        if (term.length() > 2) {
+            if (auto id = source.findTerm(term)) {
+                queryTerms[*id]++;
+            }
+        }
+    });
+
+    return dispatchScoreStorage(source.getScoreStorage(), [&](auto tag) {
+        return rank<decltype(tag)>(queryTerms, k);
+    });
+}
+
+template <typename Value>
+std::vector<SearchResult> QueryEngine::rank(const std::map<TermId, int>& queryTerms, size_t k) const {
+    std::vector<Cursor<Value>> cursors;
+    double queryNorm = 0;
+    for (const auto& [term, freq] : queryTerms) {
+        double idf = source.getIDF(term);
+        double weight = freq * idf;
+        queryNorm += weight * weight;
+        PostingsList postings = source.getPostings(term);
+        if (weight <= 0 || postings.empty()) {
+            continue;
+        }
+        Cursor<Value> cursor;
+        cursor.docIds = postings.docIds();
+        cursor.values = postings.valuesAs<Value>();
+        cursor.weight = weight * idf * postings.scale;
+        cursor.upperBound = weight * maxWeight[term];
+        cursors.push_back(cursor);
+    }
+    if (cursors.empty()) {
+        return {};
+    }
+    queryNorm = std::sqrt(queryNorm);
+
+    // Ascending upper bounds; prefixBound[i] = sum of the bounds of cursors [0, i)
+    std::sort(cursors.begin(), cursors.end(),
+        [](const auto& a, const auto& b) { return a.upperBound < b.upperBound; });
+    std::vector<double> prefixBound(cursors.size() + 1, 0.0);
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        prefixBound[i + 1] = prefixBound[i] + cursors[i].upperBound;
+    }
+
+    std::priority_queue<SearchResult, std::vector<SearchResult>, WeakerFirst> heap;
+    std::vector<double> contributions(cursors.size(), 0.0);
+    // Pruning drops only what scores strictly below the threshold: a tie may still
+    // enter the heap through its DocId, so it has to be scored in full
+    double threshold = 0;  // score of the weakest kept result once the heap is full
+    size_t essential = 0;  // cursors [0, essential) cannot produce a top-k hit on their own
+
+    while (true) {
+        // Next candidate: the smallest DocId among the essential lists
+        DocId candidate = UINT32_MAX;
+        for (size_t i = essential; i < cursors.size(); ++i) {
+            if (!cursors[i].done()) {
+                candidate = std::min(candidate, cursors[i].doc());
+            }
+        }
+        if (candidate == UINT32_MAX) {
+            break;
+        }
+
+        // Each list's contribution is kept apart and summed in list order at the end,
+        // so a score does not depend on which lists were essential at the time
+        double partial = 0;
+        for (size_t i = essential; i < cursors.size(); ++i) {
+            auto& cursor = cursors[i];
+            contributions[i] = 0;
+            if (!cursor.done() && cursor.doc() == candidate) {
+                contributions[i] = cursor.score();
+                partial += contributions[i];
+                cursor.next();
+            }
+        }
+
+        // Non-essential lists, strongest first, until the candidate cannot make it
+        bool pruned = false;
+        for (size_t i = essential; i-- > 0;) {
+            if (heap.size() == k && partial * inverseNorm[candidate] + prefixBound[i + 1] < threshold) {
+                pruned = true;
+                break;
+            }
+            auto& cursor = cursors[i];
+            contributions[i] = 0;
+            cursor.seek(candidate);
+            if (!cursor.done() && cursor.doc() == candidate) {
+                contributions[i] = cursor.score();
+                partial += contributions[i];
+            }
+        }
+        if (pruned) {
+            continue;
+        }
+        double score = 0;
+        for (double contribution : contributions) {
+            score += contribution;
+        }
+        score *= inverseNorm[candidate];
+
+        SearchResult result{ candidate, score };
+        if (heap.size() < k) {
+            heap.push(result);
+        } else if (WeakerFirst()(result, heap.top())) {
+            heap.pop();
+            heap.push(result);
+        } else {
+            continue;
+        }
+
+        if (heap.size() == k) {
+            threshold = heap.top().score;
+            while (essential < cursors.size() && prefixBound[essential + 1] < threshold) {
+                essential++;
+            }
+        }
+    }
+
+    std::vector<SearchResult> results;
+    while (!heap.empty()) {
+        results.push_back({ heap.top().doc, heap.top().score / queryNorm });
+        heap.pop();
+    }
+    std::reverse(results.begin(), results.end());
+    return results;
+}
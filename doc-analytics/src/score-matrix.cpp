@@ -0,0 +1,188 @@
+#include "score-matrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+// Scale that gives `largest` the top integer level
+template <typename Value>
+double scaleFor(double largest) {
+    if constexpr (std::is_floating_point_v<Value>) {
+        return 1.0;
+    } else {
+        constexpr double LEVELS = std::numeric_limits<Value>::max();
+        return largest > 0 ? largest / LEVELS : 1.0;
+    }
+}
+
+template <typename Value>
+Value encodeScore(double value, double scale) {
+    if constexpr (std::is_floating_point_v<Value>) {
+        return static_cast<Value>(value);
+    } else {
+        constexpr double LEVELS = std::numeric_limits<Value>::max();
+        double level = std::round(value / scale);
+        if (value > 0 && level < 1) {
+            level = 1;
+        }
+        return static_cast<Value>(std::min(level, LEVELS));
+    }
+}
+
+} // namespace
+
+double encodeScores(const double* values, size_t count, ScoreStorage storage, void* out) {
+    return dispatchScoreStorage(storage, [&](auto tag) {
+        using Value = decltype(tag);
+        double largest = 0;
+        for (size_t i = 0; i < count; ++i) {
+            largest = std::max(largest, values[i]);
+        }
+        double scale = scaleFor<Value>(largest);
+        Value* encoded = static_cast<Value*>(out);
+        for (size_t i = 0; i < count; ++i) {
+            encoded[i] = encodeScore<Value>(values[i], scale);
+        }
+        return scale;
+    });
+}
+
+ScoreMatrix::ScoreMatrix(ScoreStorage scoreStorage)
+    : storage(scoreStorage), valueSize(getScoreSize(scoreStorage)) {}
+
+size_t ScoreMatrix::getBytes() const {
+    return extents.size() * (sizeof(Extent) + sizeof(double)) +
+           indices.size() * sizeof(uint32_t) + values.size();
+}
+
+ScoreMatrix::Row ScoreMatrix::row(size_t r) const {
+    const Extent& extent = extents[r];
+    return { indices.data() + extent.begin, values.data() + extent.begin * valueSize,
+             extent.size, scales[r] };
+}
+
+void ScoreMatrix::layout(const std::vector<uint32_t>& capacities) {
+    extents.resize(capacities.size());
+    scales.assign(capacities.size(), 1.0);
+    uint64_t begin = 0;
+    for (size_t r = 0; r < capacities.size(); ++r) {
+        extents[r] = { begin, 0, capacities[r] };
+        begin += capacities[r];
+    }
+    indices.clear();
+    indices.resize(begin);
+    values.clear();
+    values.resize(begin * valueSize);
+    nonZeroCount = 0;
+}
+
+void ScoreMatrix::growRows(size_t count) {
+    if (count > extents.size()) {
+        extents.resize(count, Extent{ indices.size(), 0, 0 });
+        scales.resize(count, 1.0);
+    }
+}
+
+void ScoreMatrix::relocate(size_t r, uint32_t capacity) {
+    Extent& extent = extents[r];
+    uint64_t begin = indices.size();
+    indices.resize(begin + capacity);
+    values.resize((begin + capacity) * valueSize);
+    std::copy_n(indices.begin() + extent.begin, extent.size, indices.begin() + begin);
+    std::memcpy(values.data() + begin * valueSize, values.data() + extent.begin * valueSize,
+                extent.size * valueSize);
+    extent.begin = begin;
+    extent.capacity = capacity;
+}
+
+void ScoreMatrix::fitScale(size_t r, double largest) {
+    dispatchScoreStorage(storage, [&](auto tag) {
+        using Value = decltype(tag);
+        double scale = scaleFor<Value>(largest);
+        const Extent& extent = extents[r];
+        if (extent.size == 0) {
+            scales[r] = scale;
+            return;
+        }
+        if (scale <= scales[r]) {
+            return;
+        }
+        Value* rowValues = reinterpret_cast<Value*>(values.data()) + extent.begin;
+        for (uint32_t i = 0; i < extent.size; ++i) {
+            rowValues[i] = encodeScore<Value>(rowValues[i] * scales[r], scale);
+        }
+        scales[r] = scale;
+    });
+}
+
+void ScoreMatrix::append(size_t r, uint32_t index, double value) {
+    if (extents[r].size == extents[r].capacity) {
+        relocate(r, std::max<uint32_t>(4, extents[r].capacity * 2));
+    }
+    Extent& extent = extents[r];
+    uint64_t pos = extent.begin + extent.size++;
+    indices[pos] = index;
+    dispatchScoreStorage(storage, [&](auto tag) {
+        using Value = decltype(tag);
+        reinterpret_cast<Value*>(values.data())[pos] = encodeScore<Value>(value, scales[r]);
+    });
+    nonZeroCount++;
+}
+
+void ScoreMatrix::setRow(size_t r, const uint32_t* rowIndices, const double* rowValues, size_t count) {
+    nonZeroCount -= extents[r].size;
+    nonZeroCount += count;
+    extents[r].size = 0;
+    if (count > extents[r].capacity) {
+        relocate(r, static_cast<uint32_t>(count));
+    }
+    Extent& extent = extents[r];
+    extent.size = static_cast<uint32_t>(count);
+    std::copy(rowIndices, rowIndices + count, indices.begin() + extent.begin);
+    scales[r] = encodeScores(rowValues, count, storage, values.data() + extent.begin * valueSize);
+}
+
+void ScoreMatrix::removeEntries(size_t r, const std::vector<char>& flagged) {
+    Extent& extent = extents[r];
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < extent.size; ++i) {
+        uint64_t from = extent.begin + i;
+        if (flagged[indices[from]]) {
+            continue;
+        }
+        uint64_t to = extent.begin + kept++;
+        indices[to] = indices[from];
+        std::memmove(values.data() + to * valueSize, values.data() + from * valueSize, valueSize);
+    }
+    nonZeroCount -= extent.size - kept;
+    extent.size = kept;
+}
+
+void ScoreMatrix::clearRow(size_t r) {
+    nonZeroCount -= extents[r].size;
+    extents[r].size = 0;
+}
+
+void ScoreMatrix::compact() {
+    std::vector<uint32_t> packedIndices(nonZeroCount);
+    std::vector<unsigned char> packedValues(nonZeroCount * valueSize);
+    uint64_t begin = 0;
+    for (Extent& extent : extents) {
+        std::copy_n(indices.begin() + extent.begin, extent.size, packedIndices.begin() + begin);
+        std::memcpy(packedValues.data() + begin * valueSize, values.data() + extent.begin * valueSize,
+                    extent.size * valueSize);
+        extent = { begin, extent.size, extent.size };
+        begin += extent.size;
+    }
+    indices.swap(packedIndices);
+    values.swap(packedValues);
+}
+
+void ScoreMatrix::decodeRow(size_t r, std::vector<double>& out) const {
+    out.clear();
+    forEach(r, [&](uint32_t, double value) { out.push_back(value); });
+}
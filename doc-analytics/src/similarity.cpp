@@ -0,0 +1,213 @@
+#include "similarity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+SimilarityEngine::SimilarityEngine(const PostingsSource& source) {
+    size_t termCount = source.getTermCount();
+    size_t docCount = source.getDocumentCount();
+
+    std::vector<double> squaredNorm(docCount, 0.0);
+    for (TermId term = 0; term < termCount; ++term) {
+        double idf = source.getIDF(term);
+        forEachPosting(source, term, [&](DocId doc, double tf) {
+            squaredNorm[doc] += (tf * idf) * (tf * idf);
+        });
+    }
+    std::vector<double> inverseNorm(docCount);
+    for (DocId doc = 0; doc < docCount; ++doc) {
+        inverseNorm[doc] = squaredNorm[doc] > 0 ? 1.0 / std::sqrt(squaredNorm[doc]) : 0.0;
+    }
+
+    termWeights.offsets.assign(termCount + 1, 0);
+    maxWeight.assign(termCount, 0.0);
+    for (TermId term = 0; term < termCount; ++term) {
+        double idf = source.getIDF(term);
+        if (idf > 0) {
+            forEachPosting(source, term, [&](DocId doc, double tf) {
+                double weight = tf * idf * inverseNorm[doc];
+                if (weight > 0) {
+                    termWeights.indices.push_back(doc);
+                    termWeights.values.push_back(weight);
+                    maxWeight[term] = std::max(maxWeight[term], weight);
+                }
+            });
+        }
+        termWeights.offsets[term + 1] = termWeights.indices.size();
+    }
+    docWeights = termWeights.transpose(docCount);
+}
+
+double SimilarityEngine::similarity(DocId a, DocId b) const {
+    if (a >= getDocumentCount() || b >= getDocumentCount()) {
+        return 0.0;
+    }
+    auto left = docWeights.row(a);
+    auto right = docWeights.row(b);
+    double score = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < left.size && j < right.size) {
+        if (left.indices[i] < right.indices[j]) {
+            i++;
+        } else if (left.indices[i] > right.indices[j]) {
+            j++;
+        } else {
+            score += left.values[i++] * right.values[j++];
+        }
+    }
+    return score;
+}
+
+std::vector<SearchResult> SimilarityEngine::getNeighbours(DocId doc, size_t k) const {
+    std::vector<SearchResult> results;
+    if (doc >= getDocumentCount() || k == 0) {
+        return results;
+    }
+
+    std::vector<double> accumulator(getDocumentCount(), 0.0);
+    std::vector<DocId> touched;
+    auto row = docWeights.row(doc);
+    for (size_t i = 0; i < row.size; ++i) {
+        auto postings = termWeights.row(row.indices[i]);
+        for (size_t j = 0; j < postings.size; ++j) {
+            DocId other = postings.indices[j];
+            if (other == doc) {
+                continue;
+            }
+            if (accumulator[other] == 0) {
+                touched.push_back(other);
+            }
+            accumulator[other] += row.values[i] * postings.values[j];
+        }
+    }
+
+    results.reserve(touched.size());
+    for (DocId other : touched) {
+        results.push_back({ other, accumulator[other] });
+    }
+
+    // Higher score first, lower DocId on ties
+    auto better = [](const SearchResult& a, const SearchResult& b) {
+        return a.score != b.score ? a.score > b.score : a.doc < b.doc;
+    };
+    if (k < results.size()) {
+        std::nth_element(results.begin(), results.begin() + k, results.end(), better);
+        results.resize(k);
+    }
+    std::sort(results.begin(), results.end(), better);
+    return results;
+}
+
+void SimilarityEngine::collectPairs(DocId doc, double threshold, Scratch& scratch,
+                                    std::vector<SimilarPair>& out) const {
+    auto row = docWeights.row(doc);
+    if (row.empty()) {
+        return;
+    }
+
+    // Heaviest terms first, so the bound on what is left falls as fast as possible
+    auto& terms = scratch.terms;
+    terms.resize(row.size);
+    for (size_t i = 0; i < row.size; ++i) {
+        terms[i] = { row.values[i], row.indices[i] };
+    }
+    std::sort(terms.begin(), terms.end(),
+        [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    // remainingBound[i] bounds what any document can still collect from terms[i..]:
+    // both the sum of weight * maxWeight and, since every vector has unit length, the
+    // norm of that part of the row
+    auto& remainingBound = scratch.remainingBound;
+    remainingBound.assign(terms.size() + 1, 0.0);
+    double boundSum = 0;
+    double squaredSum = 0;
+    for (size_t i = terms.size(); i-- > 0;) {
+        boundSum += terms[i].first * maxWeight[terms[i].second];
+        squaredSum += terms[i].first * terms[i].first;
+        remainingBound[i] = std::min(boundSum, std::sqrt(squaredSum));
+    }
+
+    // Candidate generation: any later document sharing one of the scanned terms
+    auto& accumulator = scratch.accumulator;
+    auto& candidates = scratch.candidates;
+    candidates.clear();
+    size_t scanned = 0;
+    for (; scanned < terms.size() && remainingBound[scanned] >= threshold; ++scanned) {
+        auto [weight, term] = terms[scanned];
+        auto postings = termWeights.row(term);
+        size_t start = std::upper_bound(postings.indices, postings.indices + postings.size, doc) - postings.indices;
+        for (size_t j = start; j < postings.size; ++j) {
+            DocId other = postings.indices[j];
+            if (accumulator[other] == 0) {
+                candidates.push_back(other);
+            }
+            accumulator[other] += weight * postings.values[j];
+        }
+    }
+
+    // Verification: the rest of the row is dotted with each surviving candidate's row
+    for (size_t i = scanned; i < terms.size(); ++i) {
+        scratch.rowWeights[terms[i].second] = terms[i].first;
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (DocId other : candidates) {
+        double score = accumulator[other];
+        accumulator[other] = 0;
+        if (score + remainingBound[scanned] < threshold) {
+            continue;
+        }
+        if (scanned < terms.size()) {
+            auto candidateRow = docWeights.row(other);
+            for (size_t j = 0; j < candidateRow.size; ++j) {
+                score += scratch.rowWeights[candidateRow.indices[j]] * candidateRow.values[j];
+            }
+        }
+        if (score >= threshold) {
+            out.push_back({ doc, other, score });
+        }
+    }
+    for (size_t i = scanned; i < terms.size(); ++i) {
+        scratch.rowWeights[terms[i].second] = 0;
+    }
+}
+
+std::vector<SimilarPair> SimilarityEngine::findSimilarPairs(double threshold, ThreadPool* pool) const {
+    std::vector<SimilarPair> pairs;
+    if (threshold <= 0) {
+        std::cerr << "Warning: similarity threshold must be positive\n";
+        return pairs;
+    }
+
+    // The rows of a block mostly walk the same frequent postings lists, which stay in
+    // cache between rows. Each block owns its output; concatenating the outputs in block
+    // order keeps the result deterministic. The dense buffers are allocated once per
+    // task, not per block; a task takes every parts-th block, since early rows have
+    // more documents after them and so more work.
+    size_t docCount = getDocumentCount();
+    size_t blockCount = (docCount + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    size_t parts = std::min(blockCount, pool ? pool->size() : size_t(1));
+    std::vector<std::vector<SimilarPair>> blockPairs(blockCount);
+    parallelFor(pool, parts, [&](size_t part) {
+        Scratch scratch;
+        scratch.accumulator.assign(docCount, 0.0);
+        scratch.rowWeights.assign(termWeights.rowCount(), 0.0);
+        for (size_t block = part; block < blockCount; block += parts) {
+            DocId last = static_cast<DocId>(std::min(docCount, (block + 1) * BLOCK_SIZE));
+            for (DocId doc = static_cast<DocId>(block * BLOCK_SIZE); doc < last; ++doc) {
+                collectPairs(doc, threshold, scratch, blockPairs[block]);
+            }
+        }
+    });
+
+    size_t total = 0;
+    for (const auto& block : blockPairs) {
+        total += block.size();
+    }
+    pairs.reserve(total);
+    for (const auto& block : blockPairs) {
+        pairs.insert(pairs.end(), block.begin(), block.end());
+    }
+    return pairs;
+}
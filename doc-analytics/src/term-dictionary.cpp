@@ -0,0 +1,93 @@
+#include "term-dictionary.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+
+TermDictionary::TermDictionary(unsigned bits) : hashBits(std::min(bits, MAX_HASH_BITS)) {
+    if (bits > MAX_HASH_BITS) {
+        std::cerr << "Warning: hashed dictionaries use at most 2^" << MAX_HASH_BITS << " buckets\n";
+    }
+}
+
+TermDictionary::Shard& TermDictionary::shardFor(std::string_view term) {
+    return shards[std::hash<std::string_view>{}(term) % SHARD_COUNT];
+}
+
+TermId TermDictionary::hashTerm(std::string_view term, unsigned bits) {
+    size_t space = term.find(' ');
+    uint64_t hash = hashWord(term.substr(0, space));
+    while (space != std::string_view::npos) {
+        term.remove_prefix(space + 1);
+        space = term.find(' ');
+        hash = extendHash(hash, hashWord(term.substr(0, space)));
+    }
+    return getBucket(hash, bits);
+}
+
+TermId TermDictionary::intern(std::string_view term) {
+    if (hashBits != 0) {
+        return hashTerm(term, hashBits);
+    }
+    Shard& shard = shardFor(term);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.ids.find(term);
+    if (it != shard.ids.end()) {
+        return it->second;
+    }
+
+    TermId id;
+    std::string_view stored;
+    {
+        std::unique_lock<std::shared_mutex> termsLock(termsMtx);
+        id = static_cast<TermId>(terms.size());
+        terms.emplace_back(term);
+        stored = terms.back();
+    }
+
+    shard.ids.emplace(stored, id);
+    return id;
+}
+
+std::optional<TermId> TermDictionary::find(std::string_view term) {
+    if (hashBits != 0) {
+        return hashTerm(term, hashBits);
+    }
+    Shard& shard = shardFor(term);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.ids.find(term);
+    if (it == shard.ids.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+const std::string& TermDictionary::getTerm(TermId id) const {
+    static const std::string none;
+    if (hashBits != 0) {
+        return none;
+    }
+    std::shared_lock<std::shared_mutex> lock(termsMtx);
+    return terms.at(id);
+}
+
+std::string_view TermDictionary::getTermName(TermId id, std::string& buffer) const {
+    if (hashBits == 0) {
+        return getTerm(id);
+    }
+    char digits[16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), id);
+    buffer.assign(1, '#');
+    buffer.append(digits, result.ptr);
+    return buffer;
+}
+
+size_t TermDictionary::size() const {
+    if (hashBits != 0) {
+        return size_t{1} << hashBits;
+    }
+    std::shared_lock<std::shared_mutex> lock(termsMtx);
+    return terms.size();
+}
@@ -1,191 +1,884 @@
 #include "tf-idf.h"
+#include "index-file.h"
+#include "compact-postings.h"
 
-void DocumentCollection::addDocument(std::shared_ptr<DocumentStats> doc) {
-    std::lock_guard<std::mutex> lock(mtx);
-    documents.push_back(doc);
+DocumentCollection::DocumentCollection(std::shared_ptr<TermDictionary> dict)
+    : dictionary(dict), headers{ DocumentHeader{0, 0, 0} } {}
+
+void DocumentCollection::adjustFrequencies(TermCountRange terms, int delta) {
+    // Bucket the terms by stripe so every stripe lock is taken at most once per document
+    thread_local std::array<std::vector<TermId>, STRIPE_COUNT> buckets;
+    for (const auto& [term, freq] : terms) {
+        buckets[term % STRIPE_COUNT].push_back(term);
+    }
     
-    // Build global vocabulary
-    for (const auto& [term, freq] : doc->termFrequency) {
-        vocabulary.insert(term);
+    long vocabularyChange = 0;
+    for (size_t s = 0; s < STRIPE_COUNT; ++s) {
+        if (buckets[s].empty()) {
+            continue;
+        }
+        FrequencyStripe& stripe = frequencyStripes[s];
+        auto lock = contention.lock(stripe.mtx);
+        for (TermId term : buckets[s]) {
+            size_t slot = term / STRIPE_COUNT;
+            if (slot >= stripe.counts.size()) {
+                stripe.counts.resize(slot + 1, 0);
+            }
+            int before = stripe.counts[slot];
+            stripe.counts[slot] += delta;
+            vocabularyChange += (stripe.counts[slot] > 0) - (before > 0);
+        }
+        buckets[s].clear();
+    }
+    vocabularySize.fetch_add(vocabularyChange);
+}
+
+DocId DocumentCollection::addDocument(const DocumentStats& doc) {
+    DocId id;
+    {
+        auto lock = contention.lock(mtx);
+        id = static_cast<DocId>(headers.size() - 1);
+        counts.insert(counts.end(), doc.termFrequency.begin(), doc.termFrequency.end());
+        names.insert(names.end(), doc.docName.begin(), doc.docName.end());
+        headers.back().totalTerms = doc.totalTerms;
+        headers.push_back({ counts.size(), names.size(), 0 });
+        if (!doc.signature.empty() && signatures.empty()) {
+            signatures.resize(id);
+        }
+        if (!signatures.empty()) {
+            signatures.push_back(doc.signature);
+        }
+    }
+    liveDocuments.fetch_add(1);
+    
+    // Accumulate document frequencies so IDF never has to rescan the corpus
+    adjustFrequencies({ doc.termFrequency.data(), doc.termFrequency.data() + doc.termFrequency.size() }, +1);
+    return id;
+}
+
+bool DocumentCollection::removeDocument(DocId id) {
+    // The counts are copied out: the arrays may grow once the lock is released
+    thread_local TermCounts removed;
+    {
+        auto lock = contention.lock(mtx);
+        if (id + 1 >= headers.size() || headers[id].totalTerms == REMOVED) {
+            return false;
+        }
+        removed.assign(counts.begin() + headers[id].termOffset, counts.begin() + headers[id + 1].termOffset);
+        headers[id].totalTerms = REMOVED; // the slot stays so other DocIds remain valid
+    }
+    liveDocuments.fetch_sub(1);
+    
+    adjustFrequencies({ removed.data(), removed.data() + removed.size() }, -1);
+    return true;
+}
+
+bool DocumentCollection::removeDocument(const std::string& docName) {
+    DocId id = 0;
+    {
+        auto lock = contention.lock(mtx);
+        for (id = 0; id + 1 < headers.size(); ++id) {
+            const DocumentHeader& header = headers[id];
+            std::string_view name(names.data() + header.nameOffset, headers[id + 1].nameOffset - header.nameOffset);
+            if (header.totalTerms != REMOVED && name == docName) {
+                break;
+            }
+        }
+        if (id + 1 == headers.size()) {
+            return false;
+        }
     }
+    return removeDocument(id);
 }
 
 size_t DocumentCollection::getDocumentCount() const { 
-    return documents.size(); 
+    return liveDocuments; 
 }
 
-const std::set<std::string>& DocumentCollection::getVocabulary() const { 
+std::vector<TermId> DocumentCollection::getVocabulary() const { 
+    std::vector<TermId> vocabulary;
+    vocabulary.reserve(vocabularySize);
+    // One lock per stripe rather than per term
+    for (size_t s = 0; s < STRIPE_COUNT; ++s) {
+        const FrequencyStripe& stripe = frequencyStripes[s];
+        std::lock_guard<std::mutex> lock(stripe.mtx);
+        for (size_t slot = 0; slot < stripe.counts.size(); ++slot) {
+            if (stripe.counts[slot] > 0) {
+                vocabulary.push_back(static_cast<TermId>(slot * STRIPE_COUNT + s));
+            }
+        }
+    }
+    std::sort(vocabulary.begin(), vocabulary.end());
     return vocabulary; 
 }
 
-const std::vector<std::shared_ptr<DocumentStats>>& DocumentCollection::getDocuments() const {
-    return documents;
+size_t DocumentCollection::getVocabularySize() const {
+    return vocabularySize;
+}
+
+size_t DocumentCollection::getSlotCount() const {
+    return headers.size() - 1;
+}
+
+DocumentView DocumentCollection::getDocument(DocId id) const {
+    DocumentView view;
+    if (id + 1 >= headers.size() || headers[id].totalTerms == REMOVED) {
+        return view;
+    }
+    const DocumentHeader& header = headers[id];
+    const DocumentHeader& next = headers[id + 1];
+    view.docName = std::string_view(names.data() + header.nameOffset, next.nameOffset - header.nameOffset);
+    view.totalTerms = header.totalTerms;
+    view.termFrequency = { counts.data() + header.termOffset, counts.data() + next.termOffset };
+    if (id < signatures.size() && !signatures[id].empty()) {
+        view.signature = &signatures[id];
+    }
+    view.live = true;
+    return view;
+}
+
+size_t DocumentCollection::getStorageBytes() const {
+    return headers.size() * sizeof(DocumentHeader) + counts.size() * sizeof(TermCount) +
+           names.size() + signatures.size() * sizeof(MinHashSignature);
+}
+
+int DocumentCollection::getDocumentFrequency(TermId term) const {
+    const FrequencyStripe& stripe = frequencyStripes[term % STRIPE_COUNT];
+    size_t slot = term / STRIPE_COUNT;
+    std::lock_guard<std::mutex> lock(stripe.mtx);
+    return slot < stripe.counts.size() ? stripe.counts[slot] : 0;
+}
+
+TermDictionary& DocumentCollection::getDictionary() const {
+    return *dictionary;
+}
+
+ContentionCounter::Snapshot DocumentCollection::getContentionStats() const {
+    return contention.snapshot();
+}
+
+DocumentProcessor::DocumentProcessor(const std::string& path, 
+                    std::shared_ptr<DocumentCollection> coll,
+                    const ProcessingOptions& opts)
+    : filepath(path), collection(coll), options(opts) {
+    if (options.maxNgram > MAX_NGRAM || options.minNgram > options.maxNgram) {
+        std::cerr << "Warning: n-grams are limited to 1.." << MAX_NGRAM << " words\n";
+    }
+    options.maxNgram = std::clamp<size_t>(options.maxNgram, 1, MAX_NGRAM);
+    options.minNgram = std::clamp<size_t>(options.minNgram, 1, options.maxNgram);
 }
 
-int DocumentCollection::getDocumentFrequency(const std::string& term) const {
-    int count = 0;
-    for (const auto& doc : documents) {
-        if (doc->termFrequency.find(term) != doc->termFrequency.end()) {
-            count++;
+std::vector<uint64_t> DocumentProcessor::splitRanges(std::string_view text, uint64_t size) {
+    std::vector<uint64_t> bounds{0};
+    
+    std::ifstream file;
+    if (options.streaming) {
+        file.open(filepath, std::ios::binary);
+    }
+    
+    uint64_t rangeSize = std::max<uint64_t>(options.rangeSize, 1);
+    for (uint64_t pos = rangeSize; pos < size; pos += rangeSize) {
+        // Move the split forward onto whitespace so no word straddles two ranges
+        if (options.streaming) {
+            file.clear();
+            file.seekg(pos);
+            char c;
+            while (pos < size && file.get(c) &&
+                   charTables.charClass[static_cast<unsigned char>(c)] != CHAR_SPACE) {
+                ++pos;
+            }
+        } else {
+            while (pos < size &&
+                   charTables.charClass[static_cast<unsigned char>(text[pos])] != CHAR_SPACE) {
+                ++pos;
+            }
         }
+        if (pos >= size) {
+            break;
+        }
+        bounds.push_back(pos);
     }
-    return count;
+    
+    bounds.push_back(size);
+    return bounds;
 }
 
-std::string DocumentProcessor::cleanWord(const std::string& word) {
-    std::string cleaned;
-    for (char c : word) {
-        if (std::isalnum(c)) {
-            cleaned += std::tolower(c);
+void DocumentProcessor::countText(Tokenizer& tokenizer, std::string_view text, RangeCounts& range) {
+    // Phrases are made of the words that pass the length filter
+    if (collection->getDictionary().isHashed()) {
+        tokenizer.tokenize(text, [&](std::string_view term) {
+            if (term.length() > 2) {
+                countHashed(term, range);
+                range.totalTerms++;
+            }
+        });
+    } else if (options.maxNgram > 1) {
+        tokenizer.tokenize(text, [&](std::string_view term) {
+            if (term.length() > 2) {
+                countPhrases(term, range);
+                range.totalTerms++;
+            }
+        });
+    } else {
+        tokenizer.tokenize(text, [&](std::string_view term) {
+            if (term.length() > 2) { // Filter very short words
+                range.counts.add(term);
+                range.totalTerms++;
+            }
+        });
+    }
+}
+
+void DocumentProcessor::countPhrases(std::string_view word, RangeCounts& range) {
+    if (options.minNgram == 1) {
+        range.counts.add(word);
+    }
+    // Longest first: each phrase extends the one a word shorter that ended at the
+    // previous word, before that one is overwritten. The strings keep their
+    // capacity, and the counter copies each new phrase into its arena.
+    for (size_t n = std::min(options.maxNgram, range.recent + 1); n >= 2; --n) {
+        std::string& phrase = range.recentText[n];
+        phrase.assign(range.recentText[n - 1]);
+        phrase += ' ';
+        phrase += word;
+        if (n >= options.minNgram) {
+            range.counts.add(phrase);
         }
     }
-    return cleaned;
+    range.recentText[1].assign(word);
+    range.recent = std::min(range.recent + 1, MAX_NGRAM - 1);
 }
 
-DocumentProcessor::DocumentProcessor(const std::string& path, 
-                    std::shared_ptr<DocumentCollection> coll)
-    : filepath(path), collection(coll) {}
+void DocumentProcessor::countHashed(std::string_view word, RangeCounts& range) {
+    // No text is built or stored: a phrase's hash extends the hash of its first words
+    const TermDictionary& dictionary = collection->getDictionary();
+    uint64_t hash = TermDictionary::hashWord(word);
+    if (options.minNgram == 1) {
+        range.buckets.add(dictionary.getBucket(hash));
+    }
+    for (size_t n = options.maxNgram; n >= 2; --n) {
+        range.recentHash[n] = TermDictionary::extendHash(range.recentHash[n - 1], hash);
+        if (n >= options.minNgram && range.recent + 1 >= n) {
+            range.buckets.add(dictionary.getBucket(range.recentHash[n]));
+        }
+    }
+    range.recentHash[1] = hash;
+    range.recent = std::min(range.recent + 1, MAX_NGRAM - 1);
+}
 
-void DocumentProcessor::process() {
-    std::ifstream file(filepath);
+void DocumentProcessor::countStreamed(uint64_t begin, uint64_t end, RangeCounts& range) {
+    std::ifstream file(filepath, std::ios::binary);
     if (!file.is_open()) {
         std::cerr << "Warning: Could not open " << filepath << "\n";
         return;
     }
+    file.seekg(begin);
     
-    auto docStats = std::make_shared<DocumentStats>();
-    docStats->docName = fs::path(filepath).filename().string();
+    Tokenizer tokenizer;
+    std::vector<char> buffer(std::max<size_t>(options.chunkSize, 1));
+    size_t carry = 0;
+    uint64_t remaining = end - begin;
     
-    std::string line, word;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        while (iss >> word) {
-            std::string cleaned = cleanWord(word);
-            if (!cleaned.empty() && cleaned.length() > 2) { // Filter very short words
-                docStats->termFrequency[cleaned]++;
-                docStats->totalTerms++;
+    while (true) {
+        size_t want = std::min<uint64_t>(buffer.size() - carry, remaining);
+        file.read(buffer.data() + carry, want);
+        size_t got = file.gcount();
+        remaining -= got;
+        
+        size_t filled = carry + got;
+        bool last = remaining == 0 || got < want;
+        
+        // Hold back a trailing partial word; it is completed by the next chunk
+        size_t cut = filled;
+        if (!last) {
+            while (cut > 0 &&
+                   charTables.charClass[static_cast<unsigned char>(buffer[cut - 1])] != CHAR_SPACE) {
+                --cut;
+            }
+            if (cut == 0) { // a single word longer than the buffer
+                buffer.resize(buffer.size() * 2);
+                carry = filled;
+                continue;
             }
         }
+        
+        countText(tokenizer, std::string_view(buffer.data(), cut), range);
+        
+        carry = filled - cut;
+        std::copy(buffer.begin() + cut, buffer.begin() + filled, buffer.begin());
+        if (last) {
+            break;
+        }
     }
+}
+
+void DocumentProcessor::process() {
+    std::unique_ptr<MappedFile> mapped;
+    std::string_view text;
+    uint64_t size = 0;
     
-    file.close();
-    collection->addDocument(docStats);
+    if (options.streaming) {
+        std::error_code ec;
+        size = fs::file_size(filepath, ec);
+        if (ec) {
+            std::cerr << "Warning: Could not open " << filepath << "\n";
+            return;
+        }
+    } else {
+        mapped = std::make_unique<MappedFile>(filepath);
+        if (!mapped->isOpen()) {
+            std::cerr << "Warning: Could not open " << filepath << "\n";
+            return;
+        }
+        text = mapped->data();
+        size = text.size();
+    }
+    
+    // Large files are split into whitespace-aligned ranges counted in parallel
+    std::vector<uint64_t> bounds{0, size};
+    if (options.pool && size >= options.parallelThreshold) {
+        bounds = splitRanges(text, size);
+    }
+    
+    auto countRange = [&](size_t i, RangeCounts& range) {
+        if (options.streaming) {
+            countStreamed(bounds[i], bounds[i + 1], range);
+        } else {
+            thread_local Tokenizer tokenizer;
+            countText(tokenizer, text.substr(bounds[i], bounds[i + 1] - bounds[i]), range);
+        }
+    };
+    
+    if (bounds.size() == 2) {
+        RangeCounts& counts = getWorkspace(text);
+        countRange(0, counts);
+        collection->addDocument(buildStats(counts));
+        return;
+    }
+    
+    // Split files get counts of their own: while this thread waits for the ranges
+    // it may count other documents in its workspace
+    std::vector<RangeCounts> ranges;
+    for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+        ranges.emplace_back(text);
+    }
+    {
+        TaskGroup group(*options.pool);
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            group.submit([&countRange, &ranges, i]() { countRange(i, ranges[i]); });
+        }
+        group.wait();
+    }
+    
+    // Merge the ranges, then hit the shared dictionary once per distinct term
+    RangeCounts& localCounts = ranges.front();
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        for (const auto& [term, count] : ranges[i].counts.getCounts()) {
+            localCounts.counts.add(term, count);
+        }
+        for (const auto& [id, count] : ranges[i].buckets.getCounts()) {
+            localCounts.buckets.add(id, count);
+        }
+        localCounts.totalTerms += ranges[i].totalTerms;
+    }
+    collection->addDocument(buildStats(localCounts));
+}
+
+DocumentProcessor::RangeCounts& DocumentProcessor::getWorkspace(std::string_view stableText) {
+    thread_local RangeCounts workspace{std::string_view()};
+    workspace.reset(stableText);
+    return workspace;
+}
+
+DocumentStats DocumentProcessor::processText(std::string_view text) {
+    thread_local Tokenizer tokenizer;
+    RangeCounts& counts = getWorkspace(text);
+    countText(tokenizer, text, counts);
+    return buildStats(counts);
+}
+
+DocumentStats DocumentProcessor::buildStats(const RangeCounts& localCounts) {
+    DocumentStats docStats;
+    docStats.docName = fs::path(filepath).filename().string();
+    docStats.totalTerms = localCounts.totalTerms;
+
+    // Ids are collected in a per-thread buffer and sorted there, so the document
+    // gets a single exactly sized array
+    thread_local TermCounts ids;
+    ids.clear();
+    TermDictionary& dictionary = collection->getDictionary();
+    MinHasher minHasher;
+    for (const auto& [term, count] : localCounts.counts.getCounts()) {
+        ids.push_back({ dictionary.intern(term), count });
+        if (options.minHash) {
+            minHasher.add(term);
+        }
+    }
+    // A hashed dictionary has no text to intern; the buckets are the ids
+    for (const auto& [id, count] : localCounts.buckets.getCounts()) {
+        ids.push_back({ id, count });
+        if (options.minHash) {
+            minHasher.addHashed(id);
+        }
+    }
+    std::sort(ids.begin(), ids.end(),
+              [](const TermCount& a, const TermCount& b) { return a.term < b.term; });
+    docStats.termFrequency.assign(ids.begin(), ids.end());
+    docStats.signature = minHasher.getSignature();
+    return docStats;
+}
+
+IngestionEngine::IngestionEngine(std::shared_ptr<DocumentCollection> coll, size_t threadCount,
+                                 const ProcessingOptions& opts)
+    : collection(coll), pool(threadCount), options(opts) {
+    // Large files fan out onto the same pool that runs the per-file jobs
+    options.pool = &pool;
+}
+
+void IngestionEngine::submit(const std::string& path) {
+    pool.submit([this, path]() {
+        DocumentProcessor processor(path, collection, options);
+        processor.process();
+    });
+}
+
+void IngestionEngine::ingest(const std::vector<std::string>& paths) {
+    for (const auto& path : paths) {
+        submit(path);
+    }
+    wait();
+}
+
+void IngestionEngine::wait() {
+    pool.wait();
+}
+
+size_t IngestionEngine::getThreadCount() const {
+    return pool.size();
+}
+
+ThreadPool& IngestionEngine::getPool() {
+    return pool;
+}
+
+CorpusShape TFIDFMatrix::getCorpusShape() const {
+    CorpusShape corpus;
+    corpus.documents = collection->getDocumentCount();
+    if (weighting->usesAverageLength() && corpus.documents > 0) {
+        int64_t totalLength = 0;
+        for (DocId docId = 0; docId < collection->getSlotCount(); ++docId) {
+            DocumentView doc = collection->getDocument(docId);
+            if (doc) {
+                totalLength += doc.totalTerms;
+            }
+        }
+        corpus.averageLength = static_cast<double>(totalLength) / corpus.documents;
+    }
+    return corpus;
 }
 
+void TFIDFMatrix::refreshIDF(size_t termCount, const std::vector<char>* changedTerms) {
+    idf.resize(termCount, 0.0);
+    weighting->scoreTerms(*collection, changedTerms, idf);
+    indexedDocCount = collection->getDocumentCount();
+}
 
-double TFIDFMatrix::calculateTF(int termFreq, int totalTerms) {
-    return static_cast<double>(termFreq) / totalTerms;
+void TFIDFMatrix::scoreRow(const DocumentView& doc, const CorpusShape& corpus,
+                           std::vector<TermId>& terms, std::vector<double>& values) const {
+    terms.resize(doc.termFrequency.size());
+    values.resize(doc.termFrequency.size());
+    weighting->scoreDocument(doc, corpus, terms.data(), values.data());
+    if (!weighting->normalizes()) {
+        return;
+    }
+    double squaredNorm = 0;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        double score = values[i] * idf[terms[i]];
+        squaredNorm += score * score;
+    }
+    double scale = squaredNorm > 0 ? 1.0 / std::sqrt(squaredNorm) : 0.0;
+    for (double& value : values) {
+        value *= scale;
+    }
+}
+
+std::vector<TermId> TFIDFMatrix::splitTermRange(size_t termCount, size_t parts) const {
+    if (parts <= 1) {
+        return { 0, static_cast<TermId>(termCount) };
+    }
+    // Balance by DF rather than by id: early (frequent) terms own most of the postings
+    uint64_t total = 0;
+    for (TermId term = 0; term < termCount; ++term) {
+        total += collection->getDocumentFrequency(term) + 1;
+    }
+    
+    std::vector<TermId> bounds{0};
+    uint64_t seen = 0;
+    for (TermId term = 0; term < termCount && bounds.size() < parts; ++term) {
+        seen += collection->getDocumentFrequency(term) + 1;
+        if (seen * parts >= total * bounds.size()) {
+            bounds.push_back(term + 1);
+        }
+    }
+    if (bounds.back() != termCount) {
+        bounds.push_back(termCount);
+    }
+    return bounds;
 }
 
-double TFIDFMatrix::calculateIDF(int docFreq, int totalDocs) {
-    return std::log(static_cast<double>(totalDocs) / docFreq);
+namespace {
+
+// Raises `slot` to `value`; non-negative doubles order like their bit patterns
+void raiseTo(std::atomic<uint64_t>& slot, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint64_t current = slot.load(std::memory_order_relaxed);
+    while (bits > current && !slot.compare_exchange_weak(current, bits, std::memory_order_relaxed)) {
+    }
 }
 
-TFIDFMatrix::TFIDFMatrix(std::shared_ptr<DocumentCollection> coll) 
-    : collection(coll) {}
+} // namespace
 
-void TFIDFMatrix::compute() {
+void TFIDFMatrix::compute(ThreadPool* pool) {
     std::cout << "Computing TF-IDF matrix...\n";
     
-    const auto& vocabulary = collection->getVocabulary();
-    const auto& documents = collection->getDocuments();
-    int totalDocs = documents.size();
+    const DocumentCollection& documents = *collection;
+    size_t docCount = documents.getSlotCount();
+    size_t termCount = collection->getDictionary().size();
+    size_t parts = pool ? pool->size() * 4 : 1;
     
-    for (const auto& term : vocabulary) {
-        int docFreq = collection->getDocumentFrequency(term);
-        double idf = calculateIDF(docFreq, totalDocs);
-        
-        for (const auto& doc : documents) {
-            auto it = doc->termFrequency.find(term);
-            if (it != doc->termFrequency.end()) {
-                double tf = calculateTF(it->second, doc->totalTerms);
-                double tfidf = tf * idf;
-                matrix[term][doc->docName] = tfidf;
+    // Normalized values need the IDF of every term up front
+    refreshIDF(termCount, nullptr);
+    CorpusShape corpus = getCorpusShape();
+    
+    // Row sizes: a document's distinct terms, and a histogram of them per term
+    std::vector<uint32_t> docSizes(docCount, 0);
+    std::vector<uint32_t> termSizes(termCount, 0);
+    indexedDocs.assign(docCount, false);
+    for (DocId docId = 0; docId < docCount; ++docId) {
+        DocumentView doc = documents.getDocument(docId);
+        docSizes[docId] = static_cast<uint32_t>(doc.termFrequency.size());
+        indexedDocs[docId] = static_cast<bool>(doc);
+        for (const auto& [term, freq] : doc.termFrequency) {
+            termSizes[term]++;
+        }
+    }
+    docMajor.layout(docSizes);
+    termMajor.layout(termSizes);
+    
+    // Document rows in parallel, each into its own preallocated row. Quantized term
+    // rows are scaled to their largest value, so collect those on the way.
+    ScoreStorage storage = getScoreStorage();
+    bool quantized = storage == ScoreStorage::Quantized16 || storage == ScoreStorage::Quantized8;
+    std::vector<std::atomic<uint64_t>> largest(quantized ? termCount : 0);
+    size_t docParts = std::min(parts, std::max<size_t>(docCount, 1));
+    parallelFor(pool, docParts, [&](size_t part) {
+        std::vector<TermId> terms;
+        std::vector<double> values;
+        for (DocId docId = docCount * part / docParts; docId < docCount * (part + 1) / docParts; ++docId) {
+            DocumentView doc = documents.getDocument(docId);
+            if (!doc) {
+                continue;
+            }
+            scoreRow(doc, corpus, terms, values);
+            docMajor.setRow(docId, terms.data(), values.data(), terms.size());
+            for (size_t i = 0; quantized && i < terms.size(); ++i) {
+                raiseTo(largest[terms[i]], values[i]);
             }
         }
+    });
+    
+    // Term rows in one pass over the documents in order, so they come out sorted by
+    // document. Quantized documents are scored again rather than decoded, so term
+    // rows are rounded once, from the exact values.
+    for (TermId term = 0; quantized && term < termCount; ++term) {
+        uint64_t bits = largest[term].load(std::memory_order_relaxed);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        termMajor.fitScale(term, value);
+    }
+    std::vector<TermId> terms;
+    std::vector<double> values;
+    for (DocId docId = 0; docId < docCount; ++docId) {
+        if (!quantized) {
+            docMajor.forEach(docId, [&](uint32_t term, double value) { termMajor.append(term, docId, value); });
+            continue;
+        }
+        DocumentView doc = documents.getDocument(docId);
+        if (!doc) {
+            continue;
+        }
+        scoreRow(doc, corpus, terms, values);
+        for (size_t i = 0; i < terms.size(); ++i) {
+            termMajor.append(terms[i], docId, values[i]);
+        }
     }
     
+    refreshTermStatistics(nullptr, pool);
+    
     std::cout << "TF-IDF computation complete!\n";
 }
 
+bool TFIDFMatrix::update() {
+    const DocumentCollection& documents = *collection;
+    size_t termCount = collection->getDictionary().size();
+    
+    // DocIds are append-only: new documents sit past the indexed range,
+    // removed ones are indexed slots that have been emptied
+    std::vector<DocId> added, removed;
+    for (DocId docId = 0; docId < indexedDocs.size(); ++docId) {
+        if (indexedDocs[docId] && !documents.getDocument(docId)) {
+            removed.push_back(docId);
+        }
+    }
+    for (DocId docId = indexedDocs.size(); docId < documents.getSlotCount(); ++docId) {
+        if (documents.getDocument(docId)) {
+            added.push_back(docId);
+        }
+    }
+    if (added.empty() && removed.empty() && indexedDocs.size() == documents.getSlotCount()) {
+        return false;
+    }
+    // Every value depends on the average document length, and normalized values on
+    // the IDF of every term in their document; any change moves those
+    if (weighting->usesAverageLength() || weighting->normalizes()) {
+        compute();
+        return true;
+    }
+    
+    // Only the rows of changed documents and of their terms are touched
+    termMajor.growRows(termCount);
+    docMajor.growRows(documents.getSlotCount());
+    std::vector<char> changedTerms(termCount, 0);
+    std::vector<TermId> touchedTerms;
+    std::vector<char> removedDocs(indexedDocs.size(), 0);
+    for (DocId docId : removed) {
+        auto row = docMajor.row(docId);
+        for (size_t i = 0; i < row.size; ++i) {
+            if (!changedTerms[row.indices[i]]) {
+                changedTerms[row.indices[i]] = 1;
+                touchedTerms.push_back(row.indices[i]);
+            }
+        }
+        docMajor.clearRow(docId);
+        removedDocs[docId] = 1;
+    }
+    for (TermId term : touchedTerms) {
+        termMajor.removeEntries(term, removedDocs);
+    }
+    
+    // Scores of the added documents, one row each
+    CorpusShape corpus = getCorpusShape();
+    SparseMatrix<double> addedScores;
+    std::vector<TermId> terms;
+    std::vector<double> values;
+    for (DocId docId : added) {
+        scoreRow(documents.getDocument(docId), corpus, terms, values);
+        docMajor.setRow(docId, terms.data(), values.data(), terms.size());
+        addedScores.indices.insert(addedScores.indices.end(), terms.begin(), terms.end());
+        addedScores.values.insert(addedScores.values.end(), values.begin(), values.end());
+        addedScores.offsets.push_back(addedScores.indices.size());
+    }
+    
+    // Quantized rows first widen their scale to the largest value they take on, so the
+    // appends below are not clamped; kept entries are re-encoded only when it grows
+    if (getScoreStorage() == ScoreStorage::Quantized16 || getScoreStorage() == ScoreStorage::Quantized8) {
+        std::vector<double> largest(termCount, 0.0);
+        for (size_t i = 0; i < addedScores.nonZeros(); ++i) {
+            TermId term = addedScores.indices[i];
+            largest[term] = std::max(largest[term], addedScores.values[i]);
+        }
+        for (TermId term = 0; term < termCount; ++term) {
+            if (largest[term] > 0) {
+                termMajor.fitScale(term, largest[term]);
+            }
+        }
+    }
+    
+    // New documents have the largest ids, so appending keeps every row sorted
+    for (size_t a = 0; a < added.size(); ++a) {
+        for (uint64_t i = addedScores.offsets[a]; i < addedScores.offsets[a + 1]; ++i) {
+            termMajor.append(addedScores.indices[i], added[a], addedScores.values[i]);
+            changedTerms[addedScores.indices[i]] = 1;
+        }
+    }
+    
+    // Moved and shrunk rows leave unused slots behind; repack once they outnumber
+    // the entries, so the copying stays proportional to what the updates changed
+    for (ScoreMatrix* rows : { &termMajor, &docMajor }) {
+        if (rows->getUnusedSlots() > rows->nonZeros()) {
+            rows->compact();
+        }
+    }
+    
+    for (DocId docId : removed) {
+        indexedDocs[docId] = false;
+    }
+    indexedDocs.resize(documents.getSlotCount(), false);
+    for (DocId docId : added) {
+        indexedDocs[docId] = true;
+    }
+    
+    // IDF depends on the corpus size too: only when it is unchanged can the refresh
+    // be limited to the terms whose DF moved. Either way no postings are touched.
+    bool corpusResized = collection->getDocumentCount() != indexedDocCount;
+    refreshIDF(termCount, corpusResized ? nullptr : &changedTerms);
+    refreshTermStatistics(&changedTerms, nullptr);
+    return true;
+}
+
+std::vector<TermScore> TFIDFMatrix::getTopTerms(DocId doc, size_t k) const {
+    std::vector<TermScore> scores;
+    if (doc >= docMajor.rowCount() || k == 0) {
+        return scores;
+    }
+    
+    scores.reserve(docMajor.row(doc).size);
+    docMajor.forEach(doc, [&](TermId term, double value) {
+        scores.push_back({term, value * idf[term]});
+    });
+    
+    // Higher score first, lower term id on ties
+    auto better = [](const TermScore& a, const TermScore& b) {
+        return a.score != b.score ? a.score > b.score : a.term < b.term;
+    };
+    if (k < scores.size()) {
+        std::nth_element(scores.begin(), scores.begin() + k, scores.end(), better);
+        scores.resize(k);
+    }
+    std::sort(scores.begin(), scores.end(), better);
+    return scores;
+}
+
+std::vector<std::vector<TermScore>> TFIDFMatrix::getTopTermsPerDocument(size_t k, ThreadPool* pool) const {
+    size_t docCount = docMajor.rowCount();
+    std::vector<std::vector<TermScore>> result(docCount);
+    
+    size_t parts = pool ? std::min(docCount, pool->size() * 4) : 1;
+    parallelFor(pool, parts, [&](size_t part) {
+        for (DocId docId = docCount * part / parts; docId < docCount * (part + 1) / parts; ++docId) {
+            result[docId] = getTopTerms(docId, k);
+        }
+    });
+    return result;
+}
+
 void TFIDFMatrix::printTopTermsPerDocument(int topN) {
-    const auto& documents = collection->getDocuments();
+    const DocumentCollection& documents = *collection;
+    const auto& dictionary = collection->getDictionary();
     
     std::cout << "\n=== Top " << topN << " Terms per Document ===\n";
+    std::string name;
     
-    for (const auto& doc : documents) {
+    for (DocId docId = 0; docId < documents.getSlotCount(); ++docId) {
+        DocumentView doc = documents.getDocument(docId);
+        if (!doc) {
+            continue;
+        }
         std::cout << "\n" << std::string(60, '=') << "\n";
-        std::cout << "Document: " << doc->docName << "\n";
-        std::cout << "Total terms: " << doc->totalTerms << "\n";
+        std::cout << "Document: " << doc.docName << "\n";
+        std::cout << "Total terms: " << doc.totalTerms << "\n";
         std::cout << std::string(60, '-') << "\n";
         
-        // Collect TF-IDF scores for this document
-        std::vector<std::pair<std::string, double>> scores;
-        for (const auto& [term, docScores] : matrix) {
-            auto it = docScores.find(doc->docName);
-            if (it != docScores.end()) {
-                scores.push_back({term, it->second});
-            }
-        }
-        
-        // Sort by TF-IDF score
-        std::sort(scores.begin(), scores.end(),
-            [](const auto& a, const auto& b) { return a.second > b.second; });
-        
-        // Print top N
-        for (int i = 0; i < std::min(topN, (int)scores.size()); ++i) {
+        auto scores = getTopTerms(docId, std::max(topN, 0));
+        for (size_t i = 0; i < scores.size(); ++i) {
             std::cout << std::setw(3) << (i + 1) << ". "
-                        << std::setw(20) << std::left << scores[i].first
+                        << std::setw(20) << std::left << dictionary.getTermName(scores[i].term, name)
                         << " : " << std::fixed << std::setprecision(4) 
-                        << scores[i].second << "\n";
+                        << scores[i].score << "\n";
         }
     }
 }
 
-void TFIDFMatrix::printMatrix(int maxTerms) {
-    const auto& documents = collection->getDocuments();
-    const auto& vocabulary = collection->getVocabulary();
-    
-    std::cout << "\n=== TF-IDF Matrix (showing top " << maxTerms << " terms) ===\n";
+void TFIDFMatrix::refreshTermStatistics(const std::vector<char>* changedTerms, ThreadPool* pool) {
+    size_t termCount = termMajor.rowCount();
+    termStats.resize(termCount);
     
-    // Get top terms by average TF-IDF
-    std::vector<std::pair<std::string, double>> termAvgScores;
-    for (const auto& term : vocabulary) {
-        double avgScore = 0;
-        int count = 0;
-        for (const auto& [t, docScores] : matrix) {
-            if (t == term) {
-                for (const auto& [doc, score] : docScores) {
-                    avgScore += score;
-                    count++;
-                }
+    std::vector<TermId> bounds = splitTermRange(termCount, pool ? pool->size() * 4 : 1);
+    parallelFor(pool, bounds.size() - 1, [&](size_t part) {
+        for (TermId term = bounds[part]; term < bounds[part + 1]; ++term) {
+            if (changedTerms && !(*changedTerms)[term]) {
+                continue;
             }
+            TermStatistics stats;
+            stats.docFrequency = static_cast<int>(termMajor.row(term).size);
+            termMajor.forEach(term, [&](DocId, double value) {
+                stats.sum += value;
+                stats.max = std::max(stats.max, value);
+            });
+            termStats[term] = stats;
         }
-        if (count > 0) {
-            termAvgScores.push_back({term, avgScore / count});
+    });
+}
+
+TermStatistics TFIDFMatrix::getTermStatistics(TermId term) const {
+    if (term >= termStats.size()) {
+        return TermStatistics();
+    }
+    // Stored in TF units; IDF is a per-term factor, so it scales sum and max alike
+    TermStatistics stats = termStats[term];
+    stats.sum *= idf[term];
+    stats.max *= idf[term];
+    return stats;
+}
+
+std::vector<TermScore> TFIDFMatrix::getTopTermsByMeanScore(size_t k) const {
+    std::vector<TermScore> means;
+    for (TermId term = 0; term < termStats.size(); ++term) {
+        if (termStats[term].docFrequency > 0) {
+            means.push_back({term, termStats[term].mean() * idf[term]});
         }
     }
     
-    std::sort(termAvgScores.begin(), termAvgScores.end(),
-        [](const auto& a, const auto& b) { return a.second > b.second; });
+    auto better = [](const TermScore& a, const TermScore& b) {
+        return a.score != b.score ? a.score > b.score : a.term < b.term;
+    };
+    if (k < means.size()) {
+        std::nth_element(means.begin(), means.begin() + k, means.end(), better);
+        means.resize(k);
+    }
+    std::sort(means.begin(), means.end(), better);
+    return means;
+}
+
+void TFIDFMatrix::printMatrix(int maxTerms) {
+    const DocumentCollection& documents = *collection;
+    const auto& dictionary = collection->getDictionary();
+    
+    std::cout << "\n=== TF-IDF Matrix (showing top " << maxTerms << " terms) ===\n";
+    
+    // Get top terms by average TF-IDF
+    auto termAvgScores = getTopTermsByMeanScore(std::max(maxTerms, 0));
     
     // Print header
     std::cout << std::setw(15) << "Term";
-    for (const auto& doc : documents) {
-        std::cout << std::setw(12) << doc->docName.substr(0, 10);
+    for (DocId docId = 0; docId < documents.getSlotCount(); ++docId) {
+        if (DocumentView doc = documents.getDocument(docId)) {
+            std::cout << std::setw(12) << doc.docName.substr(0, 10);
+        }
     }
-    std::cout << "\n" << std::string(15 + documents.size() * 12, '-') << "\n";
+    std::cout << "\n" << std::string(15 + collection->getDocumentCount() * 12, '-') << "\n";
     
-    // Print matrix rows
+    // Print matrix rows, walking the sparse row alongside the dense document axis
+    std::string name;
+    std::vector<double> values;
     for (int i = 0; i < std::min(maxTerms, (int)termAvgScores.size()); ++i) {
-        const auto& term = termAvgScores[i].first;
-        std::cout << std::setw(15) << term;
+        TermId term = termAvgScores[i].term;
+        std::cout << std::setw(15) << dictionary.getTermName(term, name);
         
-        for (const auto& doc : documents) {
-            auto it = matrix[term].find(doc->docName);
-            if (it != matrix[term].end()) {
+        auto row = termMajor.row(term);
+        termMajor.decodeRow(term, values);
+        size_t pos = 0;
+        for (DocId docId = 0; docId < documents.getSlotCount(); ++docId) {
+            if (!documents.getDocument(docId)) {
+                continue;
+            }
+            while (pos < row.size && row.indices[pos] < docId) {
+                pos++;
+            }
+            if (pos < row.size && row.indices[pos] == docId) {
                 std::cout << std::setw(12) << std::fixed 
-                            << std::setprecision(4) << it->second;
+                            << std::setprecision(4) << values[pos++] * idf[term];
             } else {
                 std::cout << std::setw(12) << "0.0000";
             }
@@ -194,43 +887,347 @@ void TFIDFMatrix::printMatrix(int maxTerms) {
     }
 }
 
-void TFIDFMatrix::exportToCSV(const std::string& filename) {
+namespace {
+
+void appendNumber(std::string& out, double value, int precision) {
+    char buffer[32];
+    auto result = precision > 0
+        ? std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, precision)
+        : std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+} // namespace
+
+void TFIDFMatrix::formatRows(const std::vector<TermId>& terms, size_t first, size_t last,
+                             const std::vector<DocId>& liveDocs, const ExportOptions& options,
+                             std::string& out) const {
+    const DocumentCollection& documents = *collection;
+    const auto& dictionary = collection->getDictionary();
+    
+    std::string name;
+    std::vector<double> values;
+    for (size_t i = first; i < last; ++i) {
+        TermId term = terms[i];
+        std::string_view text = dictionary.getTermName(term, name);
+        ScoreMatrix::Row row{nullptr, nullptr, 0, 1.0};
+        values.clear();
+        if (term < termMajor.rowCount()) {
+            row = termMajor.row(term);
+            termMajor.decodeRow(term, values);
+        }
+        
+        if (options.layout == ExportOptions::Layout::Triplets) {
+            for (size_t pos = 0; pos < row.size; ++pos) {
+                double score = values[pos] * idf[term];
+                DocumentView doc = documents.getDocument(row.indices[pos]);
+                if (score == 0 || !doc) {
+                    continue;
+                }
+                out += text;
+                out += options.delimiter;
+                out += doc.docName;
+                out += options.delimiter;
+                appendNumber(out, score, options.precision);
+                out += '\n';
+            }
+            continue;
+        }
+        
+        // Dense: walk the sparse row alongside the live documents
+        out += text;
+        size_t pos = 0;
+        for (DocId docId : liveDocs) {
+            while (pos < row.size && row.indices[pos] < docId) {
+                pos++;
+            }
+            out += options.delimiter;
+            if (pos < row.size && row.indices[pos] == docId) {
+                appendNumber(out, values[pos++] * idf[term], options.precision);
+            } else {
+                out += '0';
+            }
+        }
+        out += '\n';
+    }
+}
+
+void TFIDFMatrix::exportToCSV(const std::string& filename, const ExportOptions& options) {
     // Create directory if it doesn't exist
     fs::path filepath(filename);
     if (filepath.has_parent_path()) {
         fs::create_directories(filepath.parent_path());
     }
     
-    std::ofstream file(filename);
+    std::ofstream file;
+    std::vector<char> streamBuffer(std::max<size_t>(options.bufferSize, 1));
+    file.rdbuf()->pubsetbuf(streamBuffer.data(), streamBuffer.size());
+    file.open(filename, std::ios::binary);
     if (!file.is_open()) {
         std::cerr << "Error: Could not create file " << filename << "\n";
         return;
     }
     
-    const auto& documents = collection->getDocuments();
-    const auto& vocabulary = collection->getVocabulary();
+    const DocumentCollection& documents = *collection;
+    const auto vocabulary = collection->getVocabulary();
+    
+    std::vector<DocId> liveDocs;
+    for (DocId docId = 0; docId < documents.getSlotCount(); ++docId) {
+        if (documents.getDocument(docId)) {
+            liveDocs.push_back(docId);
+        }
+    }
     
     // Header
-    file << "term";
-    for (const auto& doc : documents) {
-        file << "," << doc->docName;
-    }
-    file << "\n";
-    
-    // Data rows
-    for (const auto& term : vocabulary) {
-        file << term;
-        for (const auto& doc : documents) {
-            auto it = matrix[term].find(doc->docName);
-            if (it != matrix[term].end()) {
-                file << "," << it->second;
-            } else {
-                file << ",0";
-            }
+    std::string header;
+    if (options.layout == ExportOptions::Layout::Triplets) {
+        header = std::string("term") + options.delimiter + "document" + options.delimiter + "score";
+    } else {
+        header = "term";
+        for (DocId docId : liveDocs) {
+            header += options.delimiter;
+            header += documents.getDocument(docId).docName;
+        }
+    }
+    header += '\n';
+    file.write(header.data(), header.size());
+    
+    // Rows are formatted in blocks of about 1 MB. With a pool a whole wave of
+    // blocks is formatted in parallel, then written out in order.
+    size_t rowBytes = options.layout == ExportOptions::Layout::Triplets ? 64 : liveDocs.size() * 4 + 16;
+    size_t rowsPerBlock = std::max<size_t>(1, (1 << 20) / rowBytes);
+    size_t blockCount = (vocabulary.size() + rowsPerBlock - 1) / rowsPerBlock;
+    size_t wave = options.pool ? options.pool->size() * 2 : 1;
+    
+    std::vector<std::string> blocks(std::min(wave, std::max<size_t>(blockCount, 1)));
+    for (size_t firstBlock = 0; firstBlock < blockCount; firstBlock += blocks.size()) {
+        size_t count = std::min(blocks.size(), blockCount - firstBlock);
+        parallelFor(options.pool, count, [&](size_t i) {
+            size_t block = firstBlock + i;
+            size_t first = block * rowsPerBlock;
+            size_t last = std::min(vocabulary.size(), first + rowsPerBlock);
+            blocks[i].clear();
+            formatRows(vocabulary, first, last, liveDocs, options, blocks[i]);
+        });
+        for (size_t i = 0; i < count; ++i) {
+            file.write(blocks[i].data(), blocks[i].size());
         }
-        file << "\n";
     }
     
     file.close();
+    if (!file) {
+        std::cerr << "Error: Could not write " << filename << "\n";
+        return;
+    }
     std::cout << "\nTF-IDF matrix exported to: " << filename << "\n";
 }
+
+size_t TFIDFMatrix::getTermCount() const {
+    return termMajor.rowCount();
+}
+
+size_t TFIDFMatrix::getDocumentCount() const {
+    return indexedDocs.size();
+}
+
+std::optional<TermId> TFIDFMatrix::findTerm(std::string_view term) const {
+    auto id = collection->getDictionary().find(term);
+    if (id && *id >= termMajor.rowCount()) {
+        return std::nullopt; // interned after the last compute()/update()
+    }
+    return id;
+}
+
+std::string_view TFIDFMatrix::getTerm(TermId term) const {
+    return collection->getDictionary().getTerm(term);
+}
+
+unsigned TFIDFMatrix::getHashBits() const {
+    return collection->getDictionary().getHashBits();
+}
+
+std::string_view TFIDFMatrix::getDocumentName(DocId doc) const {
+    return collection->getDocument(doc).docName;
+}
+
+double TFIDFMatrix::getIDF(TermId term) const {
+    return idf[term];
+}
+
+ScoreStorage TFIDFMatrix::getScoreStorage() const {
+    return termMajor.getStorage();
+}
+
+PostingsList TFIDFMatrix::getPostings(TermId term) const {
+    auto row = termMajor.row(term);
+    return { row.indices, row.values, row.size, row.scale };
+}
+
+size_t TFIDFMatrix::getStorageBytes() const {
+    return termMajor.getBytes() + docMajor.getBytes() + idf.size() * sizeof(double) +
+           termStats.size() * sizeof(TermStatistics);
+}
+
+namespace {
+
+// Buffered writer for the index sections; keeps every section 8-byte aligned
+class SectionWriter {
+private:
+    std::ofstream& out;
+    uint64_t position = 0;
+
+public:
+    explicit SectionWriter(std::ofstream& file) : out(file) {}
+
+    uint64_t tell() const { return position; }
+
+    void align() {
+        static const char zeros[8] = {};
+        size_t padding = (8 - position % 8) % 8;
+        out.write(zeros, padding);
+        position += padding;
+    }
+
+    void write(const void* data, size_t bytes) {
+        out.write(static_cast<const char*>(data), bytes);
+        position += bytes;
+    }
+
+    template <typename T>
+    uint64_t writeArray(const std::vector<T>& values) {
+        align();
+        uint64_t start = position;
+        write(values.data(), values.size() * sizeof(T));
+        return start;
+    }
+};
+
+} // namespace
+
+bool TFIDFMatrix::saveIndex(const std::string& filename, ScoreStorage storage, DocIdEncoding docIdEncoding) {
+    fs::path filepath(filename);
+    if (filepath.has_parent_path()) {
+        fs::create_directories(filepath.parent_path());
+    }
+    
+    // The buffer has to be set before open() for the stream to use it
+    std::ofstream file;
+    std::vector<char> streamBuffer(1 << 20);
+    file.rdbuf()->pubsetbuf(streamBuffer.data(), streamBuffer.size());
+    file.open(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not create file " << filename << "\n";
+        return false;
+    }
+    
+    const DocumentCollection& documents = *collection;
+    const auto& dictionary = collection->getDictionary();
+    size_t termCount = termMajor.rowCount();
+    size_t docCount = indexedDocs.size();
+    
+    // Flatten the strings into offset + character sections. A hashed dictionary has
+    // no strings: the index records its hash width and looks words up by hashing.
+    bool named = !dictionary.isHashed();
+    std::vector<uint64_t> termOffsets{0};
+    std::vector<char> termChars;
+    std::vector<int32_t> docFrequency(termCount);
+    for (TermId term = 0; term < termCount; ++term) {
+        if (named) {
+            const std::string& text = dictionary.getTerm(term);
+            termChars.insert(termChars.end(), text.begin(), text.end());
+            termOffsets.push_back(termChars.size());
+        }
+        docFrequency[term] = static_cast<int32_t>(termMajor.row(term).size);
+    }
+    
+    std::vector<uint32_t> sortedTerms(named ? termCount : 0);
+    for (TermId term = 0; term < sortedTerms.size(); ++term) {
+        sortedTerms[term] = term;
+    }
+    std::sort(sortedTerms.begin(), sortedTerms.end(), [&](TermId a, TermId b) {
+        return std::string_view(termChars.data() + termOffsets[a], termOffsets[a + 1] - termOffsets[a]) <
+               std::string_view(termChars.data() + termOffsets[b], termOffsets[b + 1] - termOffsets[b]);
+    });
+    
+    std::vector<uint64_t> docOffsets{0};
+    std::vector<char> docChars;
+    std::vector<int64_t> docTotals(docCount, -1);
+    for (DocId docId = 0; docId < docCount; ++docId) {
+        DocumentView doc = documents.getDocument(docId);
+        if (doc && indexedDocs[docId]) {
+            docChars.insert(docChars.end(), doc.docName.begin(), doc.docName.end());
+            docTotals[docId] = doc.totalTerms;
+        }
+        docOffsets.push_back(docChars.size());
+    }
+    
+    // Rows back to back, with the values in the requested encoding and one scale per
+    // term; rows already stored that way are copied as they are
+    size_t valueSize = getScoreSize(storage);
+    std::vector<uint64_t> postingOffsets(termCount + 1, 0);
+    std::vector<uint32_t> postingDocs;
+    std::vector<unsigned char> postingValues(termMajor.nonZeros() * valueSize);
+    std::vector<double> termScales(termCount);
+    std::vector<double> values;
+    bool packed = docIdEncoding == DocIdEncoding::Packed;
+    std::vector<uint64_t> packedDocOffsets(packed ? termCount + 1 : 0, 0);
+    for (TermId term = 0; term < termCount; ++term) {
+        auto row = termMajor.row(term);
+        postingOffsets[term + 1] = postingOffsets[term] + row.size;
+        unsigned char* out = postingValues.data() + postingOffsets[term] * valueSize;
+        if (storage == getScoreStorage()) {
+            std::memcpy(out, row.values, row.size * valueSize);
+            termScales[term] = row.scale;
+        } else {
+            termMajor.decodeRow(term, values);
+            termScales[term] = encodeScores(values.data(), values.size(), storage, out);
+        }
+        // Compressed ids: one list per term, located through its own offsets
+        if (packed) {
+            encodeDocIds(row.indices, row.size, postingDocs);
+            packedDocOffsets[term + 1] = postingDocs.size();
+        } else {
+            postingDocs.insert(postingDocs.end(), row.indices, row.indices + row.size);
+        }
+    }
+    
+    // Reserve the header, write the sections, then come back and fill it in
+    IndexHeader header{};
+    std::memcpy(header.magic, IndexHeader::MAGIC, sizeof(header.magic));
+    header.version = IndexHeader::VERSION;
+    header.headerSize = sizeof(IndexHeader);
+    header.termCount = termCount;
+    header.docCount = docCount;
+    header.nonZeros = termMajor.nonZeros();
+    header.scoreStorage = static_cast<uint32_t>(storage);
+    header.docIdEncoding = static_cast<uint32_t>(docIdEncoding);
+    header.hashBits = dictionary.getHashBits();
+    
+    SectionWriter writer(file);
+    writer.write(&header, sizeof(header));
+    header.termOffsets = writer.writeArray(termOffsets);
+    header.termChars = writer.writeArray(termChars);
+    header.sortedTerms = writer.writeArray(sortedTerms);
+    header.docOffsets = writer.writeArray(docOffsets);
+    header.docChars = writer.writeArray(docChars);
+    header.docTotals = writer.writeArray(docTotals);
+    header.docFrequency = writer.writeArray(docFrequency);
+    header.idf = writer.writeArray(idf);
+    header.postingOffsets = writer.writeArray(postingOffsets);
+    header.postingDocOffsets = packed ? writer.writeArray(packedDocOffsets) : header.postingOffsets;
+    header.postingDocs = writer.writeArray(postingDocs);
+    header.termScales = writer.writeArray(termScales);
+    header.postingValues = writer.writeArray(postingValues);
+    header.fileSize = writer.tell();
+    
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    
+    if (!file) {
+        std::cerr << "Error: Could not write index " << filename << "\n";
+        return false;
+    }
+    std::cout << "\nTF-IDF index saved to: " << filename << "\n";
+    return true;
+}
@@ -0,0 +1,168 @@
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+namespace {
+// Identifies the pool and queue of the calling worker thread, if any
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local size_t currentIndex = 0;
+}
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    threadCount = std::max<size_t>(1, threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back([this, i]() { run(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(sleepMtx);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    size_t index = (currentPool == this)
+        ? currentIndex
+        : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mtx);
+        queues[index]->tasks.push_back(std::move(task));
+        queued.fetch_add(1);
+    }
+
+    // Taking the lock orders this notify after a sleeper's predicate check
+    { std::lock_guard<std::mutex> lock(sleepMtx); }
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(sleepMtx);
+    allDone.wait(lock, [this]() { return pending.load() == 0; });
+}
+
+size_t ThreadPool::size() const {
+    return workers.size();
+}
+
+bool ThreadPool::popLocal(size_t index, Task& task) {
+    WorkQueue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mtx);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    queued.fetch_sub(1);
+    return true;
+}
+
+bool ThreadPool::steal(size_t index, Task& task) {
+    // Own queue last: only callers outside the pool get that far with it non-empty
+    for (size_t offset = 1; offset <= queues.size(); ++offset) {
+        WorkQueue& victim = *queues[(index + offset) % queues.size()];
+        std::unique_lock<std::mutex> lock(victim.mtx, std::try_to_lock);
+        if (!lock.owns_lock() || victim.tasks.empty()) {
+            continue;
+        }
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        queued.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::execute(Task& task) {
+    try {
+        task();
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Task failed: " << e.what() << "\n";
+    } catch (...) {
+        std::cerr << "Warning: Task failed with an unknown exception\n";
+    }
+
+    if (pending.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(sleepMtx);
+        allDone.notify_all();
+    }
+}
+
+bool ThreadPool::runPendingTask() {
+    size_t index = (currentPool == this) ? currentIndex : 0;
+    Task task;
+    if ((currentPool == this && popLocal(index, task)) || steal(index, task)) {
+        execute(task);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(size_t index) {
+    currentPool = this;
+    currentIndex = index;
+
+    while (true) {
+        Task task;
+        if (popLocal(index, task) || steal(index, task)) {
+            execute(task);
+            continue;
+        }
+
+        // queued counts tasks still in a deque, so a task already taken by another
+        // thread does not keep this one from sleeping
+        std::unique_lock<std::mutex> lock(sleepMtx);
+        workAvailable.wait(lock, [this]() { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+void TaskGroup::finishOne() {
+    // Decrement under the lock so wait() cannot return (and destroy the group)
+    // while this notify is still in progress
+    std::lock_guard<std::mutex> lock(mtx);
+    if (remaining.fetch_sub(1) == 1) {
+        done.notify_all();
+    }
+}
+
+void TaskGroup::submit(std::function<void()> task) {
+    remaining.fetch_add(1);
+    pool.submit([this, task = std::move(task)]() {
+        try {
+            task();
+        } catch (...) {
+            finishOne();
+            throw;
+        }
+        finishOne();
+    });
+}
+
+void TaskGroup::wait() {
+    while (remaining.load() > 0) {
+        if (pool.runPendingTask()) {
+            continue;
+        }
+        // Nothing left to help with: the group's last tasks are running elsewhere
+        std::unique_lock<std::mutex> lock(mtx);
+        done.wait_for(lock, std::chrono::milliseconds(1), [this]() { return remaining.load() == 0; });
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+}
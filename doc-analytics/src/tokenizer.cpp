@@ -0,0 +1,317 @@
+#include "tokenizer.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define DOC_ANALYTICS_HAS_X86_SIMD 1
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DOC_ANALYTICS_HAS_MMAP 1
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef DOC_ANALYTICS_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        length = static_cast<size_t>(info.st_size);
+        if (length == 0) {
+            opened = true;
+        } else {
+            void* addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                ::madvise(addr, length, MADV_SEQUENTIAL);
+                mapped = static_cast<const char*>(addr);
+                opened = true;
+            } else {
+                length = 0;
+            }
+        }
+    }
+    ::close(fd);
+    if (opened) {
+        return;
+    }
+#endif
+
+    // Not mappable (or no mmap on this platform): read it into memory instead
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return;
+    }
+    fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    opened = true;
+}
+
+MappedFile::~MappedFile() {
+#ifdef DOC_ANALYTICS_HAS_MMAP
+    if (mapped) {
+        ::munmap(const_cast<char*>(mapped), length);
+    }
+#endif
+}
+
+std::string_view MappedFile::data() const {
+    if (mapped) {
+        return std::string_view(mapped, length);
+    }
+    return std::string_view(fallback);
+}
+
+namespace {
+
+// Finishes a scan one byte at a time, resuming whatever word a block scanner left open
+size_t scanScalarFrom(const unsigned char* data, size_t size, size_t i,
+                      bool inToken, size_t start, uint8_t flags,
+                      TokenSpan* out, size_t count, size_t capacity, size_t& pos) {
+    for (; i < size; ++i) {
+        uint8_t cls = charTables.charClass[data[i]];
+        if (cls != CHAR_SPACE) {
+            if (!inToken) {
+                inToken = true;
+                start = i;
+                flags = 0;
+            }
+            flags |= cls;
+        } else if (inToken) {
+            out[count++] = { start, i - start, flags };
+            inToken = false;
+            if (count == capacity) {
+                pos = i;
+                return count;
+            }
+        }
+    }
+    if (inToken) {
+        out[count++] = { start, size - start, flags };
+    }
+    pos = size;
+    return count;
+}
+
+size_t scanScalar(std::string_view text, size_t& pos, TokenSpan* out, size_t capacity) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(text.data());
+    return scanScalarFrom(data, text.size(), pos, false, 0, 0, out, 0, capacity, pos);
+}
+
+#ifdef DOC_ANALYTICS_HAS_X86_SIMD
+
+// Class bitmasks of a 64-byte block, bit i describing byte i
+struct BlockMasks {
+    uint64_t space;
+    uint64_t upper;
+    uint64_t other;
+};
+
+constexpr size_t BLOCK_SIZE = 64;
+
+inline uint64_t bitsFrom(unsigned bit) {
+    return bit >= 64 ? 0 : ~0ULL << bit;
+}
+
+// Walks the word boundaries of whole 64-byte blocks using the masks from Classify,
+// then leaves the tail (and any word still open) to the scalar scanner. Always
+// inlined into a kernel compiled for the classifier's instruction set (scanSse2,
+// scanAvx2), so the classifier is inlined into the loop rather than called per block.
+template <BlockMasks (*Classify)(const unsigned char*)>
+__attribute__((always_inline)) inline size_t scanBlocks(std::string_view text, size_t& pos, TokenSpan* out, size_t capacity) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(text.data());
+    size_t size = text.size();
+    size_t count = 0;
+    size_t i = pos;
+
+    bool inToken = false;
+    size_t start = 0;
+    uint8_t flags = 0;
+
+    for (; i + BLOCK_SIZE <= size; i += BLOCK_SIZE) {
+        BlockMasks masks = Classify(data + i);
+        unsigned bit = 0;
+        while (bit < 64) {
+            if (!inToken) {
+                uint64_t words = ~masks.space & bitsFrom(bit);
+                if (words == 0) {
+                    break;
+                }
+                bit = __builtin_ctzll(words);
+                inToken = true;
+                start = i + bit;
+                flags = 0;
+            }
+
+            uint64_t ends = masks.space & bitsFrom(bit);
+            unsigned end = ends ? __builtin_ctzll(ends) : 64;
+            uint64_t word = bitsFrom(bit) & ~bitsFrom(end);
+            flags |= ((masks.upper & word) ? CHAR_UPPER : 0) |
+                     ((masks.other & word) ? CHAR_OTHER : 0);
+            if (end == 64) {
+                break; // the word continues into the next block
+            }
+
+            out[count++] = { start, i + end - start, flags };
+            inToken = false;
+            bit = end;
+            if (count == capacity) {
+                pos = i + end;
+                return count;
+            }
+        }
+    }
+
+    return scanScalarFrom(data, size, i, inToken, start, flags, out, count, capacity, pos);
+}
+
+__attribute__((target("sse2")))
+inline __m128i inRange128(__m128i v, char lo, char hi) {
+    // (v - lo) <= (hi - lo) as unsigned bytes
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(hi - lo)), shifted);
+}
+
+__attribute__((target("sse2")))
+inline BlockMasks classifySse2(const unsigned char* p) {
+    BlockMasks masks{ 0, 0, 0 };
+    for (unsigned k = 0; k < 4; ++k) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * k));
+        __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), inRange128(v, '\t', '\r'));
+        __m128i clean = _mm_or_si128(inRange128(v, 'a', 'z'), inRange128(v, '0', '9'));
+        __m128i upper = inRange128(v, 'A', 'Z');
+
+        uint64_t s = static_cast<uint32_t>(_mm_movemask_epi8(space));
+        uint64_t u = static_cast<uint32_t>(_mm_movemask_epi8(upper));
+        uint64_t c = static_cast<uint32_t>(_mm_movemask_epi8(clean));
+        masks.space |= s << (16 * k);
+        masks.upper |= u << (16 * k);
+        masks.other |= (~(s | u | c) & 0xFFFFu) << (16 * k);
+    }
+    return masks;
+}
+
+__attribute__((target("avx2")))
+inline __m256i inRange256(__m256i v, char lo, char hi) {
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(hi - lo)), shifted);
+}
+
+__attribute__((target("avx2")))
+inline BlockMasks classifyAvx2(const unsigned char* p) {
+    BlockMasks masks{ 0, 0, 0 };
+    for (unsigned k = 0; k < 2; ++k) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * k));
+        __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), inRange256(v, '\t', '\r'));
+        __m256i clean = _mm256_or_si256(inRange256(v, 'a', 'z'), inRange256(v, '0', '9'));
+        __m256i upper = inRange256(v, 'A', 'Z');
+
+        uint64_t s = static_cast<uint32_t>(_mm256_movemask_epi8(space));
+        uint64_t u = static_cast<uint32_t>(_mm256_movemask_epi8(upper));
+        uint64_t c = static_cast<uint32_t>(_mm256_movemask_epi8(clean));
+        masks.space |= s << (32 * k);
+        masks.upper |= u << (32 * k);
+        masks.other |= (~(s | u | c) & 0xFFFFFFFFu) << (32 * k);
+    }
+    return masks;
+}
+
+__attribute__((target("sse2")))
+size_t scanSse2(std::string_view text, size_t& pos, TokenSpan* out, size_t capacity) {
+    return scanBlocks<classifySse2>(text, pos, out, capacity);
+}
+
+__attribute__((target("avx2")))
+size_t scanAvx2(std::string_view text, size_t& pos, TokenSpan* out, size_t capacity) {
+    return scanBlocks<classifyAvx2>(text, pos, out, capacity);
+}
+
+__attribute__((target("sse2")))
+void lowercaseSse2(const char* src, size_t length, size_t readable, char* dst) {
+    size_t i = 0;
+    for (; i < length && i + 16 <= readable; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i upper = inRange128(v, 'A', 'Z');
+        v = _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+    for (; i < length; ++i) {
+        char c = src[i];
+        dst[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 0x20) : c;
+    }
+}
+
+#endif // DOC_ANALYTICS_HAS_X86_SIMD
+
+} // namespace
+
+bool isScanKernelSupported(ScanKernel kernel) {
+    switch (kernel) {
+    case ScanKernel::Auto:
+    case ScanKernel::Scalar:
+        return true;
+#ifdef DOC_ANALYTICS_HAS_X86_SIMD
+    case ScanKernel::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case ScanKernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* getScanKernelName(ScanKernel kernel) {
+    switch (kernel) {
+    case ScanKernel::Auto:   return "auto";
+    case ScanKernel::Scalar: return "scalar";
+    case ScanKernel::SSE2:   return "sse2";
+    case ScanKernel::AVX2:   return "avx2";
+    }
+    return "unknown";
+}
+
+ScanFunction resolveScanKernel(ScanKernel kernel) {
+    if (kernel == ScanKernel::Auto) {
+        static const ScanKernel best =
+            isScanKernelSupported(ScanKernel::AVX2) ? ScanKernel::AVX2 :
+            isScanKernelSupported(ScanKernel::SSE2) ? ScanKernel::SSE2 : ScanKernel::Scalar;
+        kernel = best;
+    }
+    if (!isScanKernelSupported(kernel)) {
+        kernel = ScanKernel::Scalar;
+    }
+
+    switch (kernel) {
+#ifdef DOC_ANALYTICS_HAS_X86_SIMD
+    case ScanKernel::SSE2:
+        return scanSse2;
+    case ScanKernel::AVX2:
+        return scanAvx2;
+#endif
+    default:
+        return scanScalar;
+    }
+}
+
+void lowercaseAscii(const char* src, size_t length, size_t readable, char* dst) {
+#ifdef DOC_ANALYTICS_HAS_X86_SIMD
+    static const bool hasSse2 = isScanKernelSupported(ScanKernel::SSE2);
+    if (hasSse2) {
+        lowercaseSse2(src, length, readable, dst);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < length; ++i) {
+        char c = src[i];
+        dst[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 0x20) : c;
+    }
+}